@@ -0,0 +1,417 @@
+/*
+ * End-to-end benchmark driver.
+ *
+ * Generates families of instances (random G(n,p), grids, trees, Paley graphs,
+ * planted low twin-width graphs and disjoint unions of many components),
+ * runs the solver on each of them in a child process under a time budget,
+ * and records the wall time of each phase of the solver,
+ * the width of the returned sequence and the final lb/ub gap.
+ * Results are written as one JSON record per instance.
+ *
+ * Usage: macro_bench [--families gnp,grid,tree,paley,planted,union]
+ *                    [--seeds K] [--seed S] [--budget SECONDS]
+ *                    [--out results.jsonl] [--dump DIR] [--verbose]
+ */
+#include <array>
+#include <chrono>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <poll.h>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "graph.h"
+#include "solver.h"
+#include "timing.h"
+
+using namespace std;
+using namespace std::chrono;
+
+struct Instance
+{
+	string family;
+	string name;
+	int n;
+	contr_seq edges; // 0-indexed
+};
+
+/*************** Generators ***************/
+Instance gnp(int n, double p, RNG &rng)
+{
+	uniform_real_distribution unif(0.0, 1.0);
+	ostringstream name;
+	name << "gnp_n" << n << "_p" << p;
+	Instance res{"gnp", name.str(), n, {}};
+	for (int u = 0; u < n; ++u)
+		for (int v = u + 1; v < n; ++v)
+			if (unif(rng) < p)
+				res.edges.emplace_back(u, v);
+	return res;
+}
+
+Instance grid(int r, int c)
+{
+	Instance res{"grid", "grid_" + to_string(r) + "x" + to_string(c), r * c, {}};
+	for (int i = 0; i < r; ++i)
+		for (int j = 0; j < c; ++j)
+		{
+			if (i + 1 < r)
+				res.edges.emplace_back(i * c + j, (i + 1) * c + j);
+			if (j + 1 < c)
+				res.edges.emplace_back(i * c + j, i * c + j + 1);
+		}
+	return res;
+}
+
+// Random recursive tree: each vertex is attached to a uniformly chosen earlier vertex.
+Instance tree(int n, RNG &rng)
+{
+	Instance res{"tree", "tree_n" + to_string(n), n, {}};
+	for (int u = 1; u < n; ++u)
+		res.edges.emplace_back(uniform_int_distribution<int>(0, u - 1)(rng), u);
+	return res;
+}
+
+// Paley graph on Z_q, q prime with q = 1 mod 4: u ~ v iff u - v is a nonzero square.
+Instance paley(int q)
+{
+	Instance res{"paley", "paley_q" + to_string(q), q, {}};
+	vector<bool> square(q, false);
+	for (int x = 1; x < q; ++x)
+		square[(x * x) % q] = true;
+	for (int u = 0; u < q; ++u)
+		for (int v = u + 1; v < q; ++v)
+			if (square[v - u])
+				res.edges.emplace_back(u, v);
+	return res;
+}
+
+/*
+ * Graph of bandwidth at most `w` (each vertex only sees some of the `w` previous ones),
+ * in which each vertex is then replaced by a random module of size at most `module`.
+ * Contracting each module, then merging consecutive vertices of the band
+ * gives a sequence of width O(w): the twin-width of these graphs is planted.
+ */
+Instance planted(int n, int w, int module, RNG &rng)
+{
+	uniform_real_distribution unif(0.0, 1.0);
+	uniform_int_distribution<int> msize(1, module);
+	Instance res{"planted", "planted_n" + to_string(n) + "_w" + to_string(w) + "_m" + to_string(module), 0, {}};
+
+	// Each band vertex becomes a module, with edges of a random cograph-like structure inside.
+	vector<vector<int>> modules(n);
+	for (int i = 0; i < n; ++i)
+	{
+		int s = msize(rng);
+		bool clique = unif(rng) < 0.5;
+		for (int j = 0; j < s; ++j)
+		{
+			if (clique)
+				for (int x: modules[i])
+					res.edges.emplace_back(x, res.n);
+			modules[i].push_back(res.n++);
+		}
+	}
+
+	for (int i = 0; i < n; ++i)
+		for (int j = max(0, i - w); j < i; ++j)
+			if (unif(rng) < 0.5)
+				for (int x: modules[i])
+					for (int y: modules[j])
+						res.edges.emplace_back(x, y);
+	return res;
+}
+
+// Disjoint union of `count` small components from the other families.
+Instance disjoint_union(int count, RNG &rng)
+{
+	Instance res{"union", "union_c" + to_string(count), 0, {}};
+	uniform_int_distribution<int> kind(0, 2), size(4, 24);
+	for (int i = 0; i < count; ++i)
+	{
+		int s = size(rng);
+		int k = kind(rng);
+		Instance c = (k == 0) ? gnp(s, 0.3, rng) : (k == 1) ? tree(s, rng) : grid(2, s / 2);
+		for (auto [u, v]: c.edges)
+			res.edges.emplace_back(u + res.n, v + res.n);
+		res.n += c.n;
+	}
+	return res;
+}
+
+vector<Instance> generate(const string &family, RNG &rng)
+{
+	vector<Instance> res;
+	if (family == "gnp")
+	{
+		for (int n: {20, 30, 50})
+			for (double p: {0.1, 0.3, 0.5})
+				res.push_back(gnp(n, p, rng));
+		for (int n: {1000, 5000})
+			res.push_back(gnp(n, 3.0 / n, rng));
+	}
+	else if (family == "grid")
+	{
+		for (int s: {4, 8, 15, 40, 100})
+			res.push_back(grid(s, s));
+		res.push_back(grid(3, 1000));
+	}
+	else if (family == "tree")
+	{
+		for (int n: {50, 250, 2000, 20000})
+			res.push_back(tree(n, rng));
+	}
+	else if (family == "paley")
+	{
+		for (int q: {13, 17, 29})
+			res.push_back(paley(q));
+	}
+	else if (family == "planted")
+	{
+		for (int n: {20, 60, 500})
+			for (int w: {1, 2})
+				res.push_back(planted(n, w, 4, rng));
+	}
+	else if (family == "union")
+	{
+		for (int c: {20, 200, 2000})
+			res.push_back(disjoint_union(c, rng));
+	}
+	else
+		cerr << "Unknown family: " << family << endl;
+
+	return res;
+}
+
+string to_gr(const Instance &inst)
+{
+	ostringstream os;
+	os << "p tww " << inst.n << " " << inst.edges.size() << "\n";
+	for (auto [u, v]: inst.edges)
+		os << u + 1 << " " << v + 1 << "\n";
+	return os.str();
+}
+
+/*************** Running ***************/
+struct Record
+{
+	string status;
+	double wall_s = 0;
+	std::array<double, (int)Phase::Count> phase_s{};
+	int width = -1, lb = 0, ub = 0;
+
+	void write_json(ostream &os) const
+	{
+		os << "\"status\": \"" << status << "\", \"wall_s\": " << wall_s;
+		if (status != "ok" && status != "invalid")
+			return;
+		for (int i = 0; i < (int)Phase::Count; ++i)
+			os << ", \"" << PHASE_NAMES[i] << "_s\": " << phase_s[i];
+		os << ", \"width\": " << width
+		   << ", \"lb\": " << lb
+		   << ", \"ub\": " << ub
+		   << ", \"gap\": " << width - lb;
+	}
+};
+
+// Width of `seq` on g, or -1 if seq is not a valid contraction sequence.
+int replay_width(Graph g, const contr_seq &seq)
+{
+	for (auto [u, v]: seq)
+	{
+		if (u == v || g.is_deleted(u) || g.is_deleted(v))
+			return -1;
+		g.merge_nohint(u, v);
+	}
+	return (g.actual_n() == 1) ? g.full_width() : -1;
+}
+
+/*
+ * Runs in the child process: solves the instance and
+ * returns the fields of its Record, separated by spaces.
+ */
+string run_child(const string &gr)
+{
+	profile().reset();
+	auto start = steady_clock::now();
+	istringstream is(gr);
+	Graph g = [&] {
+		PhaseTimer t(Phase::Parse);
+		return Graph::from_istream(is);
+	}();
+	Graph g0 = g;
+	contr_seq sol = solve(g);
+	double wall = duration<double>(steady_clock::now() - start).count();
+
+	int width = replay_width(move(g0), sol);
+	const auto &p = profile();
+	ostringstream os;
+	os << (width >= 0 ? "ok" : "invalid") << " " << wall;
+	for (double x: p.seconds)
+		os << " " << x;
+	os << " " << width << " " << p.lb << " " << p.ub;
+	return os.str();
+}
+
+/*
+ * Solves the instance in a forked child, so that it can be killed
+ * when it exceeds its time budget.
+ */
+Record run_with_budget(const Instance &inst, double budget_s, bool verbose)
+{
+	string gr = to_gr(inst);
+	int fd[2];
+	if (pipe(fd) != 0)
+		return Record{"error"};
+
+	auto start = steady_clock::now();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(fd[0]);
+		if (!verbose)
+		{
+			int null = open("/dev/null", O_WRONLY);
+			dup2(null, STDERR_FILENO);
+		}
+		string res = run_child(gr);
+		ssize_t written = write(fd[1], res.data(), res.size());
+		_exit(written == (ssize_t)res.size() ? 0 : 1);
+	}
+	close(fd[1]);
+
+	string res;
+	char buf[4096];
+	bool timeout = false;
+	while (true)
+	{
+		double left = budget_s - duration<double>(steady_clock::now() - start).count();
+		if (left <= 0)
+		{
+			timeout = true;
+			break;
+		}
+		pollfd pfd{fd[0], POLLIN, 0};
+		if (poll(&pfd, 1, (int)(left * 1000) + 1) == 0)
+			continue;
+		ssize_t r = read(fd[0], buf, sizeof(buf));
+		if (r <= 0)
+			break;
+		res.append(buf, r);
+	}
+	close(fd[0]);
+
+	if (timeout)
+		kill(pid, SIGKILL);
+	int status;
+	waitpid(pid, &status, 0);
+
+	Record rec;
+	if (timeout)
+	{
+		rec.status = "timeout";
+		rec.wall_s = budget_s;
+		return rec;
+	}
+
+	istringstream is(res);
+	if (!(is >> rec.status >> rec.wall_s))
+		return Record{"crash"};
+	for (double &x: rec.phase_s)
+		is >> x;
+	is >> rec.width >> rec.lb >> rec.ub;
+	return rec;
+}
+
+int main(int argc, char **argv)
+{
+	string families = "gnp,grid,tree,paley,planted,union";
+	int seeds = 1;
+	uint64_t seed = 42;
+	double budget = 60;
+	string out, dump;
+	bool verbose = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--verbose")
+		{
+			verbose = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			cerr << "Missing value for " << arg << endl;
+			return 1;
+		}
+		string val = argv[++i];
+		if (arg == "--families")
+			families = val;
+		else if (arg == "--seeds")
+			seeds = stoi(val);
+		else if (arg == "--seed")
+			seed = stoull(val);
+		else if (arg == "--budget")
+			budget = stod(val);
+		else if (arg == "--out")
+			out = val;
+		else if (arg == "--dump")
+			dump = val;
+		else
+		{
+			cerr << "Unknown argument: " << arg << endl;
+			return 1;
+		}
+	}
+
+	ofstream ofs;
+	if (!out.empty())
+		ofs.open(out);
+	ostream &os = out.empty() ? cout : ofs;
+
+	struct Summary { int count = 0, solved = 0; double wall = 0; long long gap = 0; };
+	map<string, Summary> summary;
+
+	istringstream fam_stream(families);
+	string family;
+	while (getline(fam_stream, family, ','))
+		for (int s = 0; s < seeds; ++s)
+		{
+			RNG rng(seed + s);
+			for (auto &inst: generate(family, rng))
+			{
+				string name = inst.name + "_s" + to_string(seed + s);
+				if (!dump.empty())
+					ofstream(dump + "/" + name + ".gr") << to_gr(inst);
+
+				Record rec = run_with_budget(inst, budget, verbose);
+				os << "{\"family\": \"" << family << "\", \"name\": \"" << name << "\""
+				   << ", \"n\": " << inst.n << ", \"m\": " << inst.edges.size()
+				   << ", \"budget_s\": " << budget << ", ";
+				rec.write_json(os);
+				os << "}" << endl;
+
+				auto &sum = summary[family];
+				sum.count++;
+				if (rec.status == "ok")
+				{
+					sum.solved++;
+					sum.wall += rec.wall_s;
+					sum.gap += rec.width - rec.lb;
+				}
+				cerr << name << ": " << rec.status << " in " << rec.wall_s << "s" << endl;
+			}
+		}
+
+	cerr << "family, solved/count, total wall time of solved (s), total gap of solved" << endl;
+	for (auto &[fam, s]: summary)
+		cerr << fam << ", " << s.solved << "/" << s.count << ", " << s.wall << ", " << s.gap << endl;
+
+	return 0;
+}
@@ -0,0 +1,425 @@
+/*
+ * Microbenchmarks for the hot kernels of the solver:
+ * LongBitset operations, BitGraph contractions and kernelization,
+ * Graph merges and twin merging, subgraph_lb and first_merge_lb.
+ *
+ * All inputs are generated from a fixed seed, so two runs
+ * of the same binary measure exactly the same work.
+ * Results are written as JSON (to stdout, or to the file given with --out).
+ *
+ * Usage: bench [--seed S] [--reps R] [--filter substring] [--out file.json]
+ */
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "common.h"
+#include "long_bitset.hpp"
+#include "bgraph.h"
+#include "graph.h"
+#include "bab.h"
+#include "lower_bound.h"
+#include "first_merge_lb.h"
+
+using namespace std;
+using namespace std::chrono;
+
+using Params = map<string, double>;
+
+struct Result
+{
+	string name;
+	Params params;
+	long long ops;
+	double median_ns, min_ns, max_ns;
+};
+
+struct Runner
+{
+	uint64_t seed;
+	int reps;
+	string filter;
+	vector<Result> results;
+
+	/*
+	 * Runs `setup` (untimed) then `batch` (timed) `reps` times.
+	 * `batch` returns the number of operations it performed,
+	 * and we report the time per operation.
+	 */
+	template <class Setup, class Batch>
+	void run(const string &name, const Params &params, Setup &&setup, Batch &&batch)
+	{
+		if (name.find(filter) == string::npos)
+			return;
+
+		vector<double> per_op;
+		long long ops = 0;
+		for (int r = 0; r < reps; ++r)
+		{
+			setup();
+			auto start = steady_clock::now();
+			ops = batch();
+			double ns = duration<double, nano>(steady_clock::now() - start).count();
+			per_op.push_back(ns / max(ops, 1LL));
+		}
+		sort(per_op.begin(), per_op.end());
+		results.push_back({name, params, ops, per_op[per_op.size() / 2], per_op.front(), per_op.back()});
+		cerr << name << ": " << per_op[per_op.size() / 2] << " ns/op" << endl;
+	}
+
+	template <class Batch>
+	void run(const string &name, const Params &params, Batch &&batch)
+	{
+		run(name, params, [] {}, batch);
+	}
+
+	void write_json(ostream &os) const
+	{
+		os << "{\n  \"seed\": " << seed << ",\n  \"reps\": " << reps << ",\n  \"benchmarks\": [\n";
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const auto &r = results[i];
+			os << "    {\"name\": \"" << r.name << "\", \"params\": {";
+			bool first = true;
+			for (auto &[k, v]: r.params)
+			{
+				os << (first ? "" : ", ") << "\"" << k << "\": " << v;
+				first = false;
+			}
+			os << "}, \"ops\": " << r.ops
+			   << ", \"median_ns\": " << r.median_ns
+			   << ", \"min_ns\": " << r.min_ns
+			   << ", \"max_ns\": " << r.max_ns << "}"
+			   << (i + 1 < results.size() ? ",\n" : "\n");
+		}
+		os << "  ]\n}\n";
+	}
+};
+
+// Prevents the compiler from optimizing away a computed value.
+template <class T>
+inline void keep(const T &x)
+{
+	asm volatile("" : : "r,m"(x) : "memory");
+}
+
+/*************** Synthetic inputs ***************/
+// G(n, p), 0-indexed.
+contr_seq random_edges(int n, double p, RNG &rng)
+{
+	uniform_real_distribution unif(0.0, 1.0);
+	contr_seq res;
+	for (int u = 0; u < n; ++u)
+		for (int v = u + 1; v < n; ++v)
+			if (unif(rng) < p)
+				res.emplace_back(u, v);
+	return res;
+}
+
+// Sparse random graph with n vertices and about n * avg_deg / 2 edges.
+contr_seq sparse_edges(int n, double avg_deg, RNG &rng)
+{
+	uniform_int_distribution<int> unif(0, n - 1);
+	contr_seq res;
+	long long m = (long long)n * avg_deg / 2;
+	for (long long i = 0; i < m; ++i)
+		res.emplace_back(unif(rng), unif(rng));
+	return res;
+}
+
+// Adds `copies` false twins of random vertices, so that kernelization has work to do.
+contr_seq plant_twins(int &n, contr_seq edges, int copies, RNG &rng)
+{
+	vector<vector<int>> adj(n);
+	for (auto [u, v]: edges)
+	{
+		adj[u].push_back(v);
+		adj[v].push_back(u);
+	}
+	uniform_int_distribution<int> unif(0, n - 1);
+	for (int i = 0; i < copies; ++i)
+	{
+		int x = unif(rng);
+		for (int w: adj[x])
+			edges.emplace_back(n, w);
+		++n;
+	}
+	return edges;
+}
+
+BitGraph dense_graph(int n, double p, RNG &rng)
+{
+	auto g = Graph::from_edges(n, random_edges(n, p, rng));
+	return g.subgraph(g.vertices());
+}
+
+vector<contr> random_pairs(const vector<int> &vx, int count, RNG &rng)
+{
+	uniform_int_distribution<int> unif(0, vx.size() - 1);
+	vector<contr> res;
+	while ((int)res.size() < count)
+	{
+		int u = vx[unif(rng)], v = vx[unif(rng)];
+		if (u != v)
+			res.emplace_back(u, v);
+	}
+	return res;
+}
+
+/*************** Benchmarks ***************/
+using Bs = BitGraph::VxContainer;
+
+void bench_bitset(Runner &r, RNG &rng)
+{
+	constexpr int COUNT = 1024;
+	constexpr int ROUNDS = 64;
+	uniform_real_distribution unif(0.0, 1.0);
+	for (double density: {0.05, 0.5})
+	{
+		vector<Bs> sets(COUNT);
+		for (auto &s: sets)
+			for (int i = 0; i < Bs::MAX_SIZE; ++i)
+				if (unif(rng) < density)
+					s.insert(i);
+
+		Params p{{"density", density}, {"bits", Bs::MAX_SIZE}};
+		auto binary = [&](const string &name, auto &&op) {
+			r.run("bitset/" + name, p, [&] {
+				for (int k = 0; k < ROUNDS; ++k)
+					for (int i = 0; i + 1 < COUNT; ++i)
+						keep(op(sets[i], sets[i + 1]));
+				return (long long)ROUNDS * (COUNT - 1);
+			});
+		};
+		binary("and", [](const Bs &a, const Bs &b) -> Bs { return a & b; });
+		binary("or", [](const Bs &a, const Bs &b) -> Bs { return a | b; });
+		binary("xor", [](const Bs &a, const Bs &b) -> Bs { return a ^ b; });
+		binary("minus", [](const Bs &a, const Bs &b) -> Bs { return a - b; });
+		binary("subset", [](const Bs &a, const Bs &b) { return a <= b; });
+		binary("merge_expr", [](const Bs &a, const Bs &b) { return (a | b | (a ^ b)).size(); });
+
+		r.run("bitset/size", p, [&] {
+			for (int k = 0; k < ROUNDS; ++k)
+				for (auto &s: sets)
+					keep(s.size());
+			return (long long)ROUNDS * COUNT;
+		});
+		r.run("bitset/iterate", p, [&] {
+			long long ops = 0;
+			for (auto &s: sets)
+				for (int x: s)
+				{
+					keep(x);
+					++ops;
+				}
+			return ops;
+		});
+	}
+}
+
+void bench_bgraph(Runner &r, RNG &rng)
+{
+	constexpr int PAIRS = 4096;
+	for (int n: {32, 128, 256})
+		for (double density: {0.1, 0.5})
+		{
+			Params p{{"n", n}, {"density", density}};
+			auto g = dense_graph(n, density, rng);
+			vector<int> vx;
+			g.iter_nodes([&](int u) { vx.push_back(u); });
+			auto pairs = random_pairs(vx, PAIRS, rng);
+
+			r.run("bgraph/merge_cost", p, [&] {
+				for (auto [u, v]: pairs)
+					keep(g.merge_cost(u, v));
+				return (long long)pairs.size();
+			});
+
+			r.run("bgraph/contract", p, [&] {
+				for (auto [u, v]: pairs)
+					keep(g.contract(u, v).full_width());
+				return (long long)pairs.size();
+			});
+
+			// Contract the graph down to n/2 vertices with random merges.
+			BitGraph h = g;
+			vector<contr> steps;
+			r.run("bgraph/merge", p, [&] {
+				h = g;
+				vector<int> alive = vx;
+				shuffle(alive.begin(), alive.end(), rng);
+				steps.clear();
+				for (int i = 0; i < n / 2; ++i)
+					steps.emplace_back(alive[2 * i], alive[2 * i + 1]);
+			}, [&] {
+				for (auto [u, v]: steps)
+					h.merge_nohint(u, v);
+				keep(h.full_width());
+				return (long long)steps.size();
+			});
+
+			r.run("bgraph/options", p, [&] {
+				keep(g.options().size());
+				return 1LL;
+			});
+		}
+
+	for (int n: {64, 128})
+	{
+		int n2 = n;
+		auto edges = plant_twins(n2, random_edges(n, 0.3, rng), n, rng);
+		auto G = Graph::from_edges(n2, edges);
+		auto g = G.subgraph(G.vertices());
+		BitGraph h = g;
+		r.run("bgraph/kernelize", {{"n", n2}, {"twins", n}}, [&] { h = g; }, [&] {
+			keep(h.kernelize().size());
+			return 1LL;
+		});
+	}
+}
+
+void bench_graph(Runner &r, RNG &rng)
+{
+	for (int n: {1000, 10000})
+		for (double deg: {4.0, 16.0})
+		{
+			Params p{{"n", n}, {"avg_deg", deg}};
+			auto g = Graph::from_edges(n, sparse_edges(n, deg, rng));
+			vector<int> vx(g.vertices().begin(), g.vertices().end());
+
+			// Merge random pairs of neighbors, as close_merge_sparse does.
+			Graph h = g;
+			vector<contr> steps;
+			r.run("graph/merge", p, [&] {
+				h = g;
+				vector<int> alive = vx;
+				shuffle(alive.begin(), alive.end(), rng);
+				steps.clear();
+				for (int i = 0; i < n / 4; ++i)
+					steps.emplace_back(alive[2 * i], alive[2 * i + 1]);
+			}, [&] {
+				for (auto [u, v]: steps)
+					h.merge(u, v, h.merge_cost(u, v));
+				keep(h.full_width());
+				return (long long)steps.size();
+			});
+
+			int n2 = n;
+			auto edges = plant_twins(n2, sparse_edges(n, deg, rng), n / 4, rng);
+			auto t = Graph::from_edges(n2, edges);
+			r.run("graph/merge_twins", {{"n", n2}, {"avg_deg", deg}, {"twins", n / 4}},
+				[&] { h = t; }, [&] {
+				h.kernelize_safe();
+				keep(h.actual_n());
+				return 1LL;
+			});
+		}
+}
+
+void bench_lb(Runner &r, RNG &rng)
+{
+	constexpr int SAMPLES = 8;
+	for (int k: {12, 16})
+	{
+		auto g = dense_graph(128, 0.3, rng);
+		RNG lb_rng;
+		r.run("lb/subgraph_lb_dense", {{"n", 128}, {"density", 0.3}, {"k", k}},
+			[&] { lb_rng.seed(r.seed); }, [&] {
+			for (int i = 0; i < SAMPLES; ++i)
+				keep(subgraph_lb(g, k, 0, lb_rng));
+			return (long long)SAMPLES;
+		});
+
+		auto G = Graph::from_edges(20000, sparse_edges(20000, 8, rng));
+		r.run("lb/subgraph_lb_sparse", {{"n", 20000}, {"avg_deg", 8}, {"k", k}},
+			[&] { lb_rng.seed(r.seed); }, [&] {
+			for (int i = 0; i < SAMPLES; ++i)
+				keep(subgraph_lb(G, k, 0, lb_rng));
+			return (long long)SAMPLES;
+		});
+	}
+
+	auto G = Graph::from_edges(20000, sparse_edges(20000, 8, rng));
+	r.run("lb/first_merge_sparse", {{"n", 20000}, {"avg_deg", 8}}, [] {}, [&] {
+		keep(first_merge_lb(G));
+		return 1LL;
+	});
+	// A cycle and a hub adjacent to all its vertices but one: the hub is the middle of n^2 / 2 paths
+	for (int n: {10000, 40000})
+	{
+		contr_seq edges;
+		for (int i = 1; i <= n; ++i)
+			edges.emplace_back(i, i % n + 1);
+		for (int i = 2; i <= n; ++i)
+			edges.emplace_back(0, i);
+		auto H = Graph::from_edges(n + 1, edges);
+		r.run("lb/first_merge_hub", {{"n", n + 1}}, [] {}, [&] {
+			keep(first_merge_lb(H));
+			return 1LL;
+		});
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Runner r{42, 5, "", {}};
+	string out;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			cerr << "Missing value for " << arg << endl;
+			return 1;
+		}
+		string val = argv[++i];
+		if (arg == "--seed")
+			r.seed = stoull(val);
+		else if (arg == "--reps")
+		{
+			r.reps = stoi(val);
+			// Each benchmark reports the median, min and max of its repetitions
+			if (r.reps < 1)
+			{
+				cerr << "--reps must be at least 1" << endl;
+				return 1;
+			}
+		}
+		else if (arg == "--filter")
+			r.filter = val;
+		else if (arg == "--out")
+			out = val;
+		else
+		{
+			cerr << "Unknown argument: " << arg << endl;
+			return 1;
+		}
+	}
+
+	// Each group gets its own generator, so that filtering
+	// some benchmarks out does not change the inputs of the others.
+	vector<pair<string, function<void(Runner &, RNG &)>>> groups = {
+		{"bitset", bench_bitset},
+		{"bgraph", bench_bgraph},
+		{"graph", bench_graph},
+		{"lb", bench_lb},
+	};
+	for (size_t i = 0; i < groups.size(); ++i)
+	{
+		RNG rng(r.seed + i);
+		groups[i].second(r, rng);
+	}
+
+	if (out.empty())
+		r.write_json(cout);
+	else
+	{
+		ofstream ofs(out);
+		r.write_json(ofs);
+	}
+
+	return 0;
+}
@@ -7,78 +7,242 @@
 
 #include "common.h"
 #include "params.h"
+#include "context.h"
+#include "timing.h"
+#include "stats.h"
+#include "trace.h"
+#include "local_search.h"
+#include "canonical.h"
+#include "component_cache.h"
 
 using std::cerr;
 using std::endl;
 
+// Approximate size in memory of a memo entry
+inline long long memo_entry_bytes(const MemType::value_type &entry)
+{
+	return sizeof(entry) + entry.first.capacity();
+}
+
+/*
+ * Returns the best score from g, and lowers min_score when a full sequence is found.
+ * The memo only keeps the first move of the best sequence from each trigraph:
+ * sequences are rebuilt at the end by mem_bab_replay.
+ */
 template<class T, class Mem>
-RetValue mem_bab_aux_lb_init(T& g, int lb, int &min_score, Mem &mem)
+int mem_bab_aux_lb_init(T& g, int lb, int &min_score, Mem &mem)
 {
 	int full_width = g.full_width();
 	if (full_width >= min_score)
-		return make_pair(INFTY, contr_seq());
+	{
+		STAT_INC(prune_bound);
+		return INFTY;
+	}
 
 	int w = g.cur_width();
 	auto kernel_moves = g.kernelize();
-	kernel_moves = contr_seq(kernel_moves.rbegin(), kernel_moves.rend());
+	STAT_ADD(kernel_moves, kernel_moves.size());
 	if (g.actual_n() == 1)
 	{
 		if (full_width < min_score)
 			min_score = full_width;
-		return make_pair(w, kernel_moves);
+		return w;
 	}
 
-	auto [it, success] = mem.try_emplace(g.get_key(), INFTY, contr_seq());
+	auto [it, success] = mem.try_emplace(g.get_key(), MemEntry{INFTY, contr(-1, -1)});
 	if (success) // key was not already present
 	{
+		STAT_INC(bab_nodes);
+		STAT_INC(memo_inserts);
+		STAT_MEMO_BYTES(memo_entry_bytes(*it));
 		auto moves = g.options();
 		assert(!moves.empty());
 		for (auto &[u, v] : moves)
 		{
 			T &gp = g.contract(u, v);
-			auto &&[score, sol] = mem_bab_aux_lb_init(gp, lb, min_score, mem);
-			score = std::max(w, score);
-			if (score < it->second.first)
-			{
-				it->second.first = score;	
-				it->second.second = std::move(sol);	
-				it->second.second.emplace_back(u, v);
-				it->second.second.insert(it->second.second.end(), kernel_moves.begin(), kernel_moves.end());
-			}
+			int score = std::max(w, mem_bab_aux_lb_init(gp, lb, min_score, mem));
+			if (score < it->second.score)
+				it->second = MemEntry{score, contr(g.part(u), g.part(v))};
 			if (full_width >= min_score)
+			{
+				STAT_INC(prune_bound);
 				break;
+			}
 
 			if (min_score <= lb)
+			{
+				STAT_INC(prune_lb);
 				break;
+			}
 		}
 	}
+	else
+		STAT_INC(memo_hits);
+
+	return it->second.score;
+}
+
+/*
+ * Rebuilds the sequence of width `score` found from g by mem_bab_aux_lb_init,
+ * with the labels of g, by following the best moves of the memo.
+ * Two paths to the same partition may label its parts differently, and kernelize
+ * may then take other moves than the BaB did: if the trigraph reached is not in the memo,
+ * it is solved again, which is rare and cheap since its width is known.
+ * Returns false if that fails too (no sequence of width `score` from there).
+ */
+template<class T>
+bool mem_bab_replay(const T &g, int lb, int score, const MemType &mem, contr_seq &res)
+{
+	TraceSpan span("bab_replay", "n", g.actual_n());
+	res.clear();
+	T root = g;
+	T *cur = &root;
+	const MemType *m = &mem;
+	MemType retry;
+	while (true)
+	{
+		for (auto [u, v]: cur->kernelize())
+			res.emplace_back(cur->label(u), cur->label(v));
+		if (cur->actual_n() == 1)
+			break;
 
-	return it->second;
+		auto it = m->find(cur->get_key());
+		if (it == m->end() || it->second.move.first < 0)
+		{
+			// Solve again from here, and follow the new memo
+			MemType next;
+			int min_score = score + 1;
+			T h = *cur;
+			mem_bab_aux_lb_init(h, lb, min_score, next);
+			retry = std::move(next);
+			m = &retry;
+			it = m->find(cur->get_key());
+			if (it == m->end() || it->second.move.first < 0)
+				return false;
+		}
+
+		auto [pu, pv] = it->second.move;
+		int u = -1, v = -1;
+		for (int x: cur->vertices())
+		{
+			if (cur->part(x) == pu)
+				u = x;
+			else if (cur->part(x) == pv)
+				v = x;
+		}
+		if (u < 0 || v < 0)
+			return false;
+		res.emplace_back(cur->label(u), cur->label(v));
+		cur = &cur->contract(u, v);
+	}
+	return true;
 }
 
+/*
+ * Decision version of the BaB: is there a contraction sequence of g of width at most k?
+ * Only the contractions whose red degree stays within k are tried, cheapest first,
+ * and the search stops at the first sequence found.
+ * `failed` holds the keys of the trigraphs already known to need a width larger than k.
+ */
+template<class T, class Failed>
+bool mem_bab_decide_aux(T &g, int k, Failed &failed)
+{
+	if (g.full_width() > k)
+	{
+		STAT_INC(prune_bound);
+		return false;
+	}
+	auto kernel_moves = g.kernelize();
+	STAT_ADD(kernel_moves, kernel_moves.size());
+	if (g.full_width() > k)
+	{
+		STAT_INC(prune_bound);
+		return false;
+	}
+	if (g.actual_n() == 1)
+		return true;
+
+	if (failed.count(g.get_key()) > 0)
+	{
+		STAT_INC(memo_hits);
+		return false;
+	}
+	STAT_INC(bab_nodes);
+
+	std::vector<std::pair<int, contr>> moves;
+	for (auto [u, v]: g.options())
+	{
+		int cost = g.merge_cost(u, v).size();
+		if (cost <= k)
+			moves.emplace_back(cost, contr(u, v));
+	}
+	std::stable_sort(moves.begin(), moves.end(),
+		[](const auto &a, const auto &b) { return a.first < b.first; });
 
+	for (auto &[_, uv]: moves)
+	{
+		T &gp = g.contract(uv.first, uv.second);
+		if (mem_bab_decide_aux(gp, k, failed))
+			return true;
+	}
 
+	STAT_INC(memo_inserts);
+	failed.insert(g.get_key());
+	return false;
+}
+
+// Whether tww(g) <= k. g is kernelized in place.
 template<class T>
-RetValue mem_bab_heur_with_ub_lb(T &g, int ub, int lb)
+bool bab_decide(T &g, int k)
 {
+	TraceSpan span("bab_decide", "k", k);
+	std::unordered_set<std::string> failed;
+	return mem_bab_decide_aux(g, k, failed);
+}
+
+/*
+ * Best sequence of g of width below ub (stopping at lb), or (ub, {}) if there is none.
+ * proven is the score the BaB proved: the width of g if it is more than lb.
+ * It is below ub but the sequence is missing if the memo could not rebuild it.
+ */
+template<class T>
+RetValue mem_bab_heur_with_ub_lb(T &g, int ub, int lb, int &proven)
+{
+	TraceSpan span("bab", "n", g.actual_n());
 	int min_score = ub;
 	MemType mem;
-	auto &&[score, sol] = mem_bab_aux_lb_init(g, lb, min_score, mem);
+	T root = g;
+	mem_bab_aux_lb_init(g, lb, min_score, mem);
+	proven = min_score;
 
-	contr_seq res = contr_seq(sol.rbegin(), sol.rend());
+	contr_seq res;
+	if (min_score < ub && !mem_bab_replay(root, lb, min_score, mem, res))
+	{
+		solver_log() << "BaB sequence of width " << min_score << " lost, kept the one of width " << ub << endl;
+		min_score = ub;
+		res.clear();
+	}
+	STAT_MEMO_CLEAR();
 
 	return make_pair(min_score, res);
 }
 
+/*
+ * Solves each CC of g, and merges them.
+ * lb0 is a lower bound known from elsewhere (components do not need to do better),
+ * and budget_n is the number of vertices the time for the lower bounds is shared with.
+ */
 template<class G>
-contr_seq cc_bab_with_lb(const G &g)
+contr_seq cc_bab_with_lb(const G &g, int lb0 = 0, int budget_n = 0)
 {
 	contr_seq res = g.sol();
 
 	std::vector<bool> seen(g.n, false);
 	std::vector<int> q;
 
-	int lb = g.full_width();
+	int lb = std::max(g.full_width(), lb0);
+	if (budget_n <= 0)
+		budget_n = g.actual_n();
 	// We need to keep one representative for each CC to merge them at the end
 	std::vector<int> repr;
 	std::unordered_set<int> cc;
@@ -87,10 +251,27 @@ contr_seq cc_bab_with_lb(const G &g)
 	std::vector<int> m(g.n), m_inv(g.n);
 	auto kernelize_if_lb_gt2 = [&](BitGraph &h) {
 		// Add some kernelization if available
+		PhaseTimer t(Phase::Kernel);
 		if (lb >= 2)
 			for (auto [u, v]: h.kernelize_tww_gt2())
 				res.emplace_back(m[u], m[v]);
 	};
+	int max_ub = 0;
+	int cc_index = 0;
+	auto add_solution = [&](const contr_seq &sol) {
+		for (auto [u, v]: sol)
+			res.emplace_back(m[u], m[v]);
+
+		if (cc.size() == 1)
+			repr.push_back(*cc.begin());
+		else
+			repr.push_back(res.back().first);
+	};
+	// Isomorphism classes of the components solved so far (see canonical.h):
+	// their width, and their sequence on the positions of the vertices in refinement_order
+	std::unordered_map<std::string, std::pair<int, contr_seq>> classes;
+	std::vector<int> order, color, pos;
+	std::vector<std::pair<std::vector<int>, int>> sig;
 	for (int u: g.vertices())
 	{
 		cc.clear();
@@ -116,48 +297,118 @@ contr_seq cc_bab_with_lb(const G &g)
 
 		if (cc.size() > 0)
 		{
+			TraceSpan span("component", "n", cc.size());
 			auto h = g.dense_subgraph(cc, m_inv);
 			kernelize_if_lb_gt2(h);
 
+			// A copy of a component solved before reuses its sequence:
+			// equal keys mean that the orders map one onto the other
+			refinement_order(h, order, color, sig, INFTY);
+			std::string iso_key = adjacency_key(h, order);
+			if (auto it = classes.find(iso_key); it != classes.end())
+			{
+				auto &[width, seq] = it->second;
+				contr_seq sol;
+				for (auto [a, b]: seq)
+					sol.emplace_back(order[a], order[b]);
+				STAT_INC(component_copies);
+				max_ub = std::max(max_ub, width);
+				lb = std::max(lb, width);
+				stats_component(cc_index++, cc.size(), width, lb, width);
+				add_solution(sol);
+				continue;
+			}
+			auto add_class = [&](int width, const contr_seq &sol) {
+				pos.assign(h.n, -1);
+				for (int i = 0; i < (int)order.size(); ++i)
+					pos[order[i]] = i;
+				contr_seq seq;
+				for (auto [x, y]: sol)
+					seq.emplace_back(pos[x], pos[y]);
+				classes.emplace(std::move(iso_key), std::make_pair(width, std::move(seq)));
+			};
+
+			// A component solved by a previous run is used as is,
+			// and otherwise its cached bounds seed the search
+			CachedComponent<BitGraph> cached(h);
+			if (cached.solved(lb))
+			{
+				solver_log() << "n: " << h.actual_n() << ", cached: " << cached.entry.ub << std::endl;
+				max_ub = std::max(max_ub, cached.entry.ub);
+				lb = std::max(lb, cached.entry.ub);
+				stats_component(cc_index++, cc.size(), cached.entry.ub, lb, cached.entry.ub);
+				add_class(cached.entry.ub, cached.entry.seq);
+				add_solution(cached.entry.seq);
+				continue;
+			}
+
 			// Compute upper bound
-			auto&& [ub, sol] = best_heur(h);
-			
-			// Compute lb with time proportional to the size
-			int cc_lb_time = (h.actual_n() * LB_TIME_S) / g.actual_n();
-			int cc_lb = timed_iter_subgraph_lb_early_exit(h, ub, lb, LB_K, cc_lb_time);
+			auto&& [ub, sol] = [&] {
+				PhaseTimer t(Phase::Upper);
+				auto x = std::make_pair(cached.entry.ub, cached.entry.seq);
+				x = std::min(x, best_heur(h, x.first));
+				double beam_s = params().beam_time_s() * h.actual_n() / budget_n;
+				return std::min(x, beam_search(h, params().beam_width, params().beam_expand, x.first, beam_s));
+			}();
+			max_ub = std::max(max_ub, ub);
+
+			// Compute lb with time proportional to the size.
+			// own_lb only counts the bounds proven on this component.
+			lb = std::max(lb, cached.entry.lb);
+			int own_lb = std::max(h.full_width(), cached.entry.lb);
+			int cc_lb_time = (h.actual_n() * params().lb_time_s) / budget_n;
+			int cc_lb = [&] {
+				PhaseTimer t(Phase::Lower);
+				return timed_iter_subgraph_lb_early_exit(h, ub, lb, params().lb_k, cc_lb_time);
+			}();
+			if (cc_lb > lb)
+				own_lb = std::max(own_lb, cc_lb);
 			lb = std::max(lb, cc_lb);
 
+			// Improve the heuristic solution before the BaB, with time proportional to the size
+			if (ub > lb)
+			{
+				PhaseTimer t(Phase::Upper);
+				std::tie(ub, sol) = local_search(h, std::make_pair(ub, sol), lb, params().ls_time_s() * h.actual_n() / budget_n);
+			}
+
 			contr_seq sol2;
 			if (lb >= 2) 
+			{
+				PhaseTimer t(Phase::Kernel);
 				sol2 = h.kernelize_tww_gt2();
+			}
 
-			std::cerr << "n: " << h.actual_n()
+			solver_log() << "n: " << h.actual_n()
 					  << ", Ub: " << ub
 					  << ", cc_lb: " << cc_lb
 					  << ", lb: " << lb << std::endl;
 
-			auto&& [h_score, h_res] = mem_bab_heur_with_ub_lb(h, ub, lb);
+			int proven;
+			auto&& [h_score, h_res] = [&] {
+				PhaseTimer t(Phase::Bab);
+				return mem_bab_heur_with_ub_lb(h, ub, lb, proven);
+			}();
 			sol2.insert(sol2.end(), h_res.begin(), h_res.end());
 
-			std::cerr << "Ub: " << ub
+			solver_log() << "Ub: " << ub
 					  << ", cc_lb: " << cc_lb
 					  << ", lb: " << lb
 					  << ", bab: " << h_score << std::endl;
 			if (h_score < ub)
 				sol = sol2;
+
+			// The BaB is exhaustive unless it stopped at lb
+			int width = std::min(h_score, ub);
+			cached.store(proven > lb ? proven : own_lb, width, sol);
 			
 			// Propagate lb to other ccs:
 			// if some CC has an optimal value of W,
 			// other CCs do not need to do better.
-			lb = std::max(lb, std::min(h_score, ub));
-
-			for (auto [u, v]: sol)
-				res.emplace_back(m[u], m[v]);
-
-			if (cc.size() == 1)
-				repr.push_back(*cc.begin());
-			else
-				repr.push_back(res.back().first);
+			lb = std::max(lb, width);
+			stats_component(cc_index++, cc.size(), ub, lb, width);
+			add_class(width, sol);
+			add_solution(sol);
 		}
 	}
 
@@ -165,5 +416,8 @@ contr_seq cc_bab_with_lb(const G &g)
 	for (size_t i = 1; i < repr.size(); ++i)
 		res.emplace_back(repr[i], repr[i - 1]);
 
+	profile().lb = lb;
+	profile().ub = max_ub;
+
 	return res;
 }
@@ -1,44 +1,71 @@
 #include "bgraph.h"
 
 #include <cassert>
+#include <cstring>
 
-using namespace std;
-
-static std::random_device rd;
-static RNG rng(rd());
+#include "context.h"
 
-vector<BitGraph> BitGraph::instances = vector<BitGraph>();
+using namespace std;
 
 BitGraph::BitGraph(int n, int past_tww):
 	n(n),
 	full_tww(past_tww), cur_tww(0),
-	adj(n), red_adj(n),
+	rows(n),
 	vertex_mask(VxContainer::full(n)),
-	key(n, 0)
+	key(n, 0), labels(n)
 {
+	static_assert(VxContainer::MAX_SIZE <= 256, "labels and keys are stored on 8 bits");
 	for (int i = 0; i < n; ++i)
-		key[i] = i;
+		key[i] = labels[i] = i;
 	assert(n <= VxContainer::MAX_SIZE);
 }
 
+// Same as operator=, but reuses the memory of this graph.
 void BitGraph::copy(const BitGraph &from) {
+    n = from.n;
     full_tww = from.full_tww;
     cur_tww = from.cur_tww;
-    std::copy(from.adj.begin(), from.adj.end(), adj.begin());
-    std::copy(from.red_adj.begin(), from.red_adj.end(), red_adj.begin());
+    rows.resize(n);
+    std::memcpy(rows.data(), from.rows.data(), n * sizeof(Row));
     vertex_mask = from.vertex_mask;
-    std::copy(from.key.begin(), from.key.end(), key.begin());
+    key.assign(from.key);
+    labels.assign(from.labels.begin(), from.labels.end());
 }
 
 BitGraph &BitGraph::contract(int u, int v) const
 {
-	BitGraph &res = BitGraph::instances[actual_n()-1];
+	BitGraph &res = SolverContext::current().level(actual_n()-1);
     res.copy(*this);
 	res.cur_tww = 0;
 	res.merge_nohint(u, v);
+	// Deep in the BaB, most rows are deleted vertices:
+	// relabel the live ones so that copies and scans only touch them.
+	if (2 * res.actual_n() <= res.n)
+		res.compact();
 	return res;
 }
 
+/*
+ * Relabels the live vertices into 0..actual_n()-1, keeping their order.
+ * labels (and thus keys) are preserved, so that contractions can be
+ * mapped back to the original graph, and memo keys stay comparable.
+ */
+void BitGraph::compact()
+{
+	int k = 0;
+	for (int u: vertex_mask)
+	{
+		rows[k].black = rows[u].black.compress(vertex_mask);
+		rows[k].red = rows[u].red.compress(vertex_mask);
+		labels[k] = labels[u];
+		++k;
+	}
+	n = k;
+	rows.resize(n);
+	labels.resize(n);
+	vertex_mask = VxContainer::full(n);
+}
+
 contr_seq BitGraph::options() const
 {
 	vector<tuple<int,int,int>> tmp;
@@ -56,7 +83,7 @@ contr_seq BitGraph::options() const
 
 BitGraph::VxContainer BitGraph::merge_cost(int u, int v) const
 {
-	auto tmp = red_adj[u] | red_adj[v] | (adj[u] ^ adj[v]);
+	VxContainer tmp = rows[u].red | rows[v].red | (rows[u].black ^ rows[v].black);
 	tmp.erase(u);
 	tmp.erase(v);
 	return tmp;
@@ -68,10 +95,11 @@ BitGraph BitGraph::subgraph(BitGraph::VxContainer h) const
 {
 	BitGraph res = *this;
 	res.vertex_mask = h;
-	for (auto &a: res.adj)
-		a &= h;
-	for (auto &a: res.red_adj)
-		a &= h;
+	for (auto &r: res.rows)
+	{
+		r.black &= h;
+		r.red &= h;
+	}
 
 	res.cur_tww = 0;
 	res.compute_width();
@@ -89,25 +117,25 @@ void BitGraph::compute_width()
 void BitGraph::add_edge(int u, int v, bool red)
 {
 	assert(u != v);
-	((red) ? red_adj[u] : adj[u]).insert(v);
-	((red) ? red_adj[v] : adj[v]).insert(u);
+	(red ? rows[u].red : rows[u].black).insert(v);
+	(red ? rows[v].red : rows[v].black).insert(u);
 }
 
 
 void BitGraph::erase_edge(int u, int v, bool red)
 {
 	assert(u != v);
-	((red) ? red_adj[u] : adj[u]).erase(v);
-	((red) ? red_adj[v] : adj[v]).erase(u);
+	(red ? rows[u].red : rows[u].black).erase(v);
+	(red ? rows[v].red : rows[v].black).erase(u);
 }
 
 void BitGraph::erase(int u)
 {
-	for (int v: adj[u])
-		adj[v].erase(u);
+	for (int v: rows[u].black)
+		rows[v].black.erase(u);
 
-	for (int v: red_adj[u])
-		red_adj[v].erase(u);
+	for (int v: rows[u].red)
+		rows[v].red.erase(u);
 	
 	vertex_mask.erase(u);
 }
@@ -118,21 +146,21 @@ void BitGraph::merge(int u, int v, VxContainer &&hint)
 	erase_edge(u, v);
 	erase_edge(u, v, true);
 
-	red_adj[u] = std::move(hint);
-	adj[u] &= adj[v];
+	rows[u].red = std::move(hint);
+	rows[u].black &= rows[v].black;
 
 	// Update adjacencies on the other end of edges
-	for (int w: red_adj[u])
+	for (int w: rows[u].red)
 	{
-		red_adj[w].insert(u);
-		adj[w].erase(u);
+		rows[w].red.insert(u);
+		rows[w].black.erase(u);
 	}
 
 	erase(v);
 
 	// Update width
 	cur_tww = max(cur_tww, red_deg(u));
-	for (int w: red_adj[u])
+	for (int w: rows[u].red)
 		cur_tww = max(cur_tww, red_deg(w));
 	full_tww = max(full_tww, cur_tww);
 
@@ -141,8 +169,8 @@ void BitGraph::merge(int u, int v, VxContainer &&hint)
 
 void BitGraph::update_key(int u, int v)
 {
-	char cu = key[u];
-	char cv = key[v];
+	char cu = key[labels[u]];
+	char cv = key[labels[v]];
 	if (cu > cv)
 		swap(cu, cv);
 	assert(cu != cv);
@@ -17,12 +17,16 @@ class BitGraph
 {
 public:
 	int n;
-    static std::vector<BitGraph> instances;
 	explicit BitGraph(int n, int past_tww = 0);
 
 	using VxContainer = LongBitset<1>;
 
 	inline const std::string &get_key() const { return key; }
+	// Label of u in the graph this one was contracted from (see compact).
+	inline int label(int u) const { return labels[u]; }
+	// Identifier of the part of the root graph that u stands for: the same for all the
+	// partial trigraphs with the same partition, whatever the order of the contractions.
+	inline int part(int u) const { return (unsigned char)key[labels[u]]; }
 	// BaB functions
 	inline int full_width() const { return full_tww; }
 	inline int cur_width() const { return cur_tww; }
@@ -42,16 +46,14 @@ public:
 
 	inline VxContainer vertices() const { return vertex_mask; }
 	inline int actual_n() const { return vertex_mask.size(); }
-	inline int deg(int u) const { return adj[u].size(); }
-	inline int red_deg(int u) const { return red_adj[u].size(); }
+	inline int deg(int u) const { return rows[u].black.size(); }
+	inline int red_deg(int u) const { return rows[u].red.size(); }
 	inline int total_deg(int u) const { return deg(u) + red_deg(u); }
-	inline bool adjacent(int u, int v) const { return adj[u].contains(v) || red_adj[u].contains(v); }
-	inline VxContainer neighbors(int u)     const { return adj[u]; }
-	inline VxContainer red_neighbors(int u) const { return red_adj[u]; }
+	inline bool adjacent(int u, int v) const { return rows[u].black.contains(v) || rows[u].red.contains(v); }
+	inline VxContainer neighbors(int u)     const { return rows[u].black; }
+	inline VxContainer red_neighbors(int u) const { return rows[u].red; }
 	inline bool is_deleted(int u) const { return !vertex_mask.contains(u); }
-	inline VxContainer non_neighbors(int u) const { return ((~adj[u]) & vertex_mask) - VxContainer::singleton(u); }
-
-    inline static void init(int n) { instances = std::vector<BitGraph>(n, BitGraph(n)); }
+	inline VxContainer non_neighbors(int u) const { return ((~rows[u].black) & vertex_mask) - VxContainer::singleton(u); }
 
 	friend std::ostream &operator<<(std::ostream &os, const BitGraph &g);
 	friend class Graph;
@@ -73,10 +75,18 @@ public:
 private:
 	int full_tww;
     int cur_tww;
-	std::vector<VxContainer> adj;
-	std::vector<VxContainer> red_adj;
+	// Black and red neighborhoods of a vertex, in one cache line
+	struct alignas(64) Row
+	{
+		VxContainer black;
+		VxContainer red;
+	};
+	// All rows of the graph in a single aligned buffer
+	std::vector<Row> rows;
 	VxContainer vertex_mask;
+	// key[x] is the smallest label in the part of vertex labelled x
 	std::string key;
+	std::vector<uint8_t> labels;
 
 	void add_edge(int u, int v, bool red = false);
 	void erase_edge(int u, int v, bool red = false);
@@ -84,10 +94,11 @@ private:
 	void update_key(int u, int v);
 	void compute_width();
     void copy(const BitGraph &from);
+	void compact();
 	
 	bool dominates(int u, int v) const;
-	bool find_one_dominating(contr_seq &seq);
-	bool find_dominating(contr_seq &seq);
+	VxContainer dominated_candidates(int u) const;
+	int find_dominating(int v) const;
 	void merge_dominating(int u, int v, contr_seq &seq);
 	bool kernelize_stars();
 
@@ -103,8 +114,8 @@ inline std::ostream &operator<<(std::ostream &os, const BitGraph &g)
 	{
 		if (g.is_deleted(i))
 			continue;
-		os << i << ", " << g.adj[i] << std::endl; 
-		os << i << ", " << g.red_adj[i] << std::endl; 
+		os << i << ", " << g.rows[i].black << std::endl; 
+		os << i << ", " << g.rows[i].red << std::endl; 
 		os << "----" << std::endl;
 	}
 	return os;
@@ -1,16 +1,47 @@
 #include "bgraph.h"
 
+#include <functional>
+
 #include "union_find.hpp"
 
 using namespace std;
 
+/*
+ * Merges dominated vertices until there are none, with a worklist.
+ * Merging v into u only changes the rows of the neighbors of v (black and red),
+ * so only the pairs with one of them can become dominating.
+ * Each vertex is checked once as the dominating vertex of a pair (see dominated_candidates),
+ * and again, along with the dominated role (see find_dominating), whenever its row changes.
+ */
 contr_seq BitGraph::kernelize()
 {
 	contr_seq res;
-	bool cont = true;
-	while (cont)
+	VxContainer work = vertices(), changed;
+	auto merge = [&](int u, int v) {
+		VxContainer nbs = rows[v].black | rows[v].red;
+		work |= nbs;
+		changed |= nbs;
+		merge_dominating(u, v, res);
+	};
+
+	while (!work.empty())
 	{
-		cont = find_dominating(res);
+		int u = *work.begin();
+		work.erase(u);
+		if (is_deleted(u))
+			continue;
+
+		for (int v: dominated_candidates(u))
+			if (dominates(u, v))
+				merge(u, v);
+
+		if (changed.contains(u))
+		{
+			changed.erase(u);
+			int x = find_dominating(u);
+			if (x >= 0)
+				merge(x, u);
+		}
 	}
 	return res;
 }
@@ -22,60 +53,52 @@ contr_seq BitGraph::kernelize()
 // This generalizes twinness to vertices with red edges
 bool BitGraph::dominates(int u, int v) const
 {
-	VxContainer nu = adj[u];
-	nu.erase(v);
-	VxContainer rnu = red_adj[u];
-	rnu.erase(v);
-
-	VxContainer nv = adj[v];
-	nv.erase(u);
-	VxContainer rnv = red_adj[v];
-	rnv.erase(u);
-	
-	return (nu <= nv) && (((nv - nu) | rnv) <= rnu);
+	// Neither u nor v appears in its own rows, so removing both
+	// from the left-hand sides is the same as removing v from N(u) and u from N(v).
+	VxContainer uv = VxContainer::singleton(u).insert(v);
+	const Row &ru = rows[u], &rv = rows[v];
+
+	return ((ru.black - uv) <= rv.black) && ((((rv.black - ru.black) | rv.red) - uv) <= ru.red);
 }
 
 /*
- * Faster version of find_one_dominating:
- * we take a vertex u, and take the intersection of the neighborhoods
- * of its neighbors. Any vertex v != u in the resulting set contains N[u]:
- * it is a candidate for domination.
+ * The vertices that u may dominate: we take the intersection of the neighborhoods
+ * of the neighbors of u. Any vertex v != u in the resulting set contains N(u).
  */
-bool BitGraph::find_one_dominating(contr_seq &seq)
+BitGraph::VxContainer BitGraph::dominated_candidates(int u) const
 {
-	for (int u: vertices())
-	{
-		VxContainer candidates = vertices() - VxContainer::singleton(u);
-		for (int w: neighbors(u))
-			candidates &= neighbors(w);
-
-		bool erased = false;
-		for (int v: candidates)
-			if (dominates(u, v))
-			{
-				merge_dominating(u, v, seq);
-				erased = true;
-			}
-		if (erased)
-			return true;
-	}
-	return false;
+	VxContainer res = vertices() - VxContainer::singleton(u);
+	for (int w: neighbors(u))
+		res &= neighbors(w);
+	return res;
 }
 
-bool BitGraph::find_dominating(contr_seq &seq)
+/*
+ * A vertex that dominates v, among the ones whose neighborhood is contained in N(v)
+ * (v is one of their dominated_candidates), or -1.
+ * All the neighbors of v but x must be neighbors of x: x is at distance at most 2 from v,
+ * unless v is isolated.
+ */
+int BitGraph::find_dominating(int v) const
 {
-
-	bool cont = true, res = false;
-	while (cont)
+	const Row &rv = rows[v];
+	VxContainer candidates;
+	if ((rv.black | rv.red).empty())
+		candidates = vertices();
+	else
 	{
-		cont = find_one_dominating(seq);
-		res = res || cont;
+		candidates = rv.red;
+		for (int z: rv.black | rv.red)
+			candidates |= rows[z].black | rows[z].red;
 	}
+	candidates -= rv.black | VxContainer::singleton(v);
 
-	return res;
+	for (int x: candidates)
+		if (rows[x].black <= rv.black && dominates(x, v))
+			return x;
+	return -1;
 }
 
-
 void BitGraph::merge_dominating(int u, int v, contr_seq &seq)
 {
 	erase(v);
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "params.h"
+
+/*
+ * The edges of h in `order`: a header with the number of vertices and the full width,
+ * then 2 bits per pair of vertices, 0 (no edge), 1 (black) or 2 (red).
+ * For small dense trigraphs: the key has k^2 / 8 bytes.
+ */
+template<class G>
+std::string adjacency_key(const G &h, const std::vector<int> &order)
+{
+	int k = order.size();
+	std::string res = std::to_string(k) + ":" + std::to_string(h.full_width()) + ":";
+	unsigned char byte = 0;
+	int bits = 0;
+	for (int i = 0; i < k; ++i)
+	{
+		auto black = h.neighbors(order[i]), red = h.red_neighbors(order[i]);
+		for (int j = i + 1; j < k; ++j)
+		{
+			int e = black.contains(order[j]) ? 1 : (red.contains(order[j]) ? 2 : 0);
+			byte |= e << bits;
+			bits += 2;
+			if (bits == 8)
+			{
+				res.push_back(byte);
+				byte = 0;
+				bits = 0;
+			}
+		}
+	}
+	res.push_back(byte);
+	return res;
+}
+
+namespace canonical_detail
+{
+using Signatures = std::vector<std::pair<std::vector<int>, int>>;
+
+/*
+ * Color refinement of the vertices vx of h, from `classes` colors 0, 1, ...:
+ * the new color of u is its rank among the signatures
+ * (old color of u, sorted colors of its black and red neighbors).
+ * Red neighbors are told apart by adding k to their color.
+ * As the old color comes first, classes only split, and keep their relative order.
+ * Returns the number of colors.
+ */
+template<class G>
+int refine(const G &h, const std::vector<int> &vx, std::vector<int> &color, Signatures &sig,
+		   int classes, int max_rounds)
+{
+	int k = vx.size();
+	sig.resize(k);
+	for (int round = 0; round < std::min(k, max_rounds); ++round)
+	{
+		for (int i = 0; i < k; ++i)
+		{
+			int u = vx[i];
+			auto &s = sig[i].first;
+			s.clear();
+			s.push_back(color[u]);
+			for (int w: h.neighbors(u))
+				s.push_back(color[w]);
+			for (int w: h.red_neighbors(u))
+				s.push_back(k + color[w]);
+			std::sort(s.begin() + 1, s.end());
+			sig[i].second = u;
+		}
+		std::sort(sig.begin(), sig.end());
+
+		int c = 0;
+		for (int i = 0; i < k; ++i)
+		{
+			if (i > 0 && sig[i].first != sig[i - 1].first)
+				++c;
+			color[sig[i].second] = c;
+		}
+		if (c + 1 == classes)
+			break;
+		classes = c + 1;
+	}
+	return classes;
+}
+
+// Gives v a color of its own, just before the other vertices of its class
+inline void individualize(const std::vector<int> &vx, std::vector<int> &color, int v)
+{
+	int c = color[v];
+	for (int u: vx)
+		if (color[u] > c || (color[u] == c && u != v))
+			++color[u];
+}
+
+/*
+ * Individualization-refinement: each node of the search tree refines its colors, then individualizes
+ * in turn each vertex of its first smallest class of several vertices. At the leaves, all the vertices
+ * have distinct colors, which order them; the smallest adjacency_key over the leaves is canonical.
+ *
+ * A leaf with the key of the first leaf gives an automorphism, that fixes the vertices individualized
+ * on the common part of their paths: a node of the first path skips its children in the orbit
+ * (under the automorphisms that fix it) of a child already searched.
+ */
+template<class G>
+class Search
+{
+public:
+	std::string best_key;
+	std::vector<int> best_order;
+	// Leaves that can still be compared: when none are left, best_order is not canonical
+	int leaves_left;
+
+	Search(const G &h, const std::vector<int> &vx, Signatures &sig, int max_rounds, int max_leaves):
+		leaves_left(max_leaves), h(h), vx(vx), sig(sig), max_rounds(max_rounds) { }
+
+	// diverged is the depth of the last node of the first path on the path to this node
+	void run(std::vector<int> color, int classes, int depth, int diverged)
+	{
+		int k = vx.size();
+		classes = refine(h, vx, color, sig, classes, max_rounds);
+		if (classes == k)
+		{
+			leaf(color, diverged);
+			return;
+		}
+
+		std::vector<int> size(classes, 0);
+		for (int u: vx)
+			++size[color[u]];
+		int target = -1;
+		for (int c = 0; c < classes; ++c)
+			if (size[c] > 1 && (target < 0 || size[c] < size[target]))
+				target = c;
+
+		bool first_path = diverged == depth;
+		if (first_path)
+		{
+			orbits.emplace_back(h.n);
+			std::iota(orbits.back().begin(), orbits.back().end(), 0);
+		}
+		std::vector<int> searched;
+		for (int v: vx)
+		{
+			if (color[v] != target)
+				continue;
+			if (leaves_left <= 0)
+				return;
+			if (first_path && std::any_of(searched.begin(), searched.end(),
+					[&](int w) { return find(depth, w) == find(depth, v); }))
+				continue;
+			auto child = color;
+			individualize(vx, child, v);
+			run(std::move(child), classes + 1, depth + 1, (first_path && searched.empty()) ? depth + 1 : diverged);
+			searched.push_back(v);
+		}
+	}
+
+private:
+	const G &h;
+	const std::vector<int> &vx;
+	Signatures &sig;
+	int max_rounds;
+	std::vector<int> first_order, order;
+	std::string first_key;
+	// orbits[d]: union-find of the orbits of the automorphisms found that fix the node of depth d of the first path
+	std::vector<std::vector<int>> orbits;
+
+	int find(int d, int u)
+	{
+		auto &p = orbits[d];
+		while (p[u] != u)
+			u = p[u] = p[p[u]];
+		return u;
+	}
+
+	void leaf(const std::vector<int> &color, int diverged)
+	{
+		--leaves_left;
+		order.resize(vx.size());
+		for (int u: vx)
+			order[color[u]] = u;
+		std::string key = adjacency_key(h, order);
+		if (first_order.empty())
+		{
+			first_order = best_order = order;
+			first_key = best_key = key;
+		}
+		else if (key == first_key)
+		{
+			for (int d = 0; d <= diverged; ++d)
+				for (int i = 0; i < (int)order.size(); ++i)
+					orbits[d][find(d, first_order[i])] = find(d, order[i]);
+		}
+		else if (key < best_key)
+		{
+			best_key = std::move(key);
+			best_order = order;
+		}
+	}
+};
+}
+
+/*
+ * Orders the vertices of the trigraph h by color refinement
+ * (1-dimensional Weisfeiler-Leman on black and red edges), stopped when the colors are stable
+ * or after max_rounds rounds. Ties are broken by individualization-refinement (see canonical_detail::Search),
+ * so that isomorphic trigraphs get the same adjacency_key in this order, unless the search needs more
+ * than max_leaves leaves, or h has more than CANONICAL_MAX_N vertices: ties are then broken by index.
+ * Equal keys always mean isomorphic trigraphs.
+ * The other arguments are scratch buffers, to be reused across calls.
+ */
+template<class G>
+void refinement_order(const G &h, std::vector<int> &order, std::vector<int> &color,
+					  std::vector<std::pair<std::vector<int>, int>> &sig, int max_rounds,
+					  int max_leaves = CANONICAL_MAX_LEAVES)
+{
+	order.clear();
+	for (int u: h.vertices())
+		order.push_back(u);
+	int k = order.size();
+	color.assign(h.n, 0);
+
+	if (k > 1 && k <= CANONICAL_MAX_N && max_leaves > 0)
+	{
+		canonical_detail::Search<G> search(h, order, sig, max_rounds, max_leaves);
+		search.run(color, 1, 0, 0);
+		order = std::move(search.best_order);
+		return;
+	}
+
+	// Vertices by color, then by index
+	canonical_detail::refine(h, order, color, sig, 1, max_rounds);
+	std::sort(order.begin(), order.end(),
+		[&](int a, int b) { return std::make_pair(color[a], a) < std::make_pair(color[b], b); });
+}
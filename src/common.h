@@ -12,7 +12,15 @@ using contr_seq = std::vector<contr>;
 using RNG = std::mt19937;
 
 using RetValue = std::pair<int, contr_seq>;
-using MemType = std::unordered_map<std::string, RetValue>;
+// Memo entry of the BaB, for a trigraph after kernelization: best score found,
+// and the first contraction of a sequence reaching it, as the parts of the two vertices
+// (see BitGraph::part). (-1, -1) if no sequence was found.
+struct MemEntry
+{
+	int score;
+	contr move;
+};
+using MemType = std::unordered_map<std::string, MemEntry>;
 constexpr int INFTY = 9999;
 
 template <class T, class U>
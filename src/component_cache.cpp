@@ -0,0 +1,128 @@
+#include "component_cache.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+// Checksum of the text of a line, written at its end: a corrupted lower bound would end searches early
+static uint64_t line_checksum(const string &text)
+{
+	component_cache_detail::Hasher h;
+	for (char c: text)
+		h.add((unsigned char)c);
+	return h.h1;
+}
+
+ComponentCache::ComponentCache(const string &path)
+{
+	ifstream ifs(path);
+	int bad = 0;
+	for (string line; getline(ifs, line);)
+	{
+		size_t last = line.rfind(' ');
+		uint64_t checksum;
+		if (last == string::npos || !(istringstream(line.substr(last + 1)) >> hex >> checksum)
+			|| checksum != line_checksum(line.substr(0, last)))
+		{
+			++bad;
+			continue;
+		}
+		istringstream is(line.substr(0, last));
+		uint64_t h1, h2;
+		int n, k;
+		Entry e;
+		if (!(is >> hex >> h1 >> h2 >> dec >> n >> e.lb >> e.ub >> k) || k < 0)
+		{
+			++bad;
+			continue;
+		}
+		e.seq.resize(k);
+		for (auto &[p, q]: e.seq)
+			is >> p >> q;
+		if (!is || e.lb > e.ub)
+		{
+			++bad;
+			continue;
+		}
+		merge(Key(h1, h2, n), move(e));
+	}
+	if (bad > 0)
+		cerr << "Component cache " << path << ": " << bad << " invalid lines ignored" << endl;
+
+	file.open(path, ios::app);
+	if (!file)
+		cerr << "Component cache " << path << " cannot be written" << endl;
+}
+
+bool ComponentCache::merge(const Key &key, Entry &&e)
+{
+	auto [it, inserted] = entries.try_emplace(key);
+	Entry &cur = it->second;
+	if (inserted)
+	{
+		cur = move(e);
+		return true;
+	}
+	bool improved = false;
+	if (e.lb > cur.lb)
+	{
+		cur.lb = e.lb;
+		improved = true;
+	}
+	if (e.ub < cur.ub)
+	{
+		cur.ub = e.ub;
+		cur.seq = move(e.seq);
+		improved = true;
+	}
+	return improved;
+}
+
+bool ComponentCache::lookup(const Key &key, const vector<int> &order, Entry &res) const
+{
+	lock_guard lock(mutex);
+	auto it = entries.find(key);
+	if (it == entries.end())
+		return false;
+
+	res.lb = it->second.lb;
+	res.ub = it->second.ub;
+	res.seq.clear();
+	for (auto [p, q]: it->second.seq)
+	{
+		if (p < 0 || q < 0 || p >= (int)order.size() || q >= (int)order.size())
+			return false;
+		res.seq.emplace_back(order[p], order[q]);
+	}
+	return true;
+}
+
+void ComponentCache::store(const Key &key, const vector<int> &order, int lb, int ub, const contr_seq &seq)
+{
+	vector<int> pos(order.empty() ? 0 : *max_element(order.begin(), order.end()) + 1, -1);
+	for (int i = 0; i < (int)order.size(); ++i)
+		pos[order[i]] = i;
+	Entry e{lb, ub, {}};
+	for (auto [u, v]: seq)
+		e.seq.emplace_back(pos[u], pos[v]);
+
+	lock_guard lock(mutex);
+	ostringstream line;
+	line << hex << get<0>(key) << " " << get<1>(key) << dec << " " << get<2>(key)
+		 << " " << lb << " " << ub << " " << e.seq.size();
+	for (auto [p, q]: e.seq)
+		line << " " << p << " " << q;
+	if (merge(key, move(e)) && file)
+		file << line.str() << " " << hex << line_checksum(line.str()) << dec << endl;
+}
+
+ComponentCache *ComponentCache::installed()
+{
+	static unique_ptr<ComponentCache> res = [] {
+		const char *path = getenv("TINYWIDTH_CACHE");
+		return path ? make_unique<ComponentCache>(path) : nullptr;
+	}();
+	return res.get();
+}
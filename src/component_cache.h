@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "common.h"
+#include "canonical.h"
+#include "context.h"
+#include "params.h"
+#include "stats.h"
+
+/*
+ * Contraction sequences of the components solved by previous runs, kept in a file,
+ * so that reruns on the same graphs, or on datasets that share components, skip them.
+ *
+ * A component (once kernelized) is identified by a 128-bit hash of its edges, listed in the order
+ * of refinement_order (canonical up to CANONICAL_MAX_N vertices, so relabelled copies share their entry),
+ * and its sequence is stored on the positions of its vertices in that order.
+ * Each entry keeps the best sequence found (of width ub), and the best lower bound proven
+ * for the component itself (not the bounds that other components gave it).
+ *
+ * The file has a line "hash1 hash2 n lb ub k p1 q1 p2 q2 ... checksum" per store,
+ * and later lines improve the previous ones. The sequences are replayed before use, but the lower bounds
+ * cannot be checked: lines with a wrong checksum, or with lb > ub, are ignored.
+ * The cache can be shared between threads.
+ */
+class ComponentCache
+{
+public:
+	// (hash1, hash2, number of vertices)
+	using Key = std::tuple<uint64_t, uint64_t, int>;
+
+	struct Entry
+	{
+		int lb = 0, ub = INFTY;
+		contr_seq seq;
+	};
+
+	explicit ComponentCache(const std::string &path);
+
+	// Key of g. order[i] is the vertex of g at position i.
+	template<class G>
+	static Key key(const G &g, std::vector<int> &order);
+
+	// The entry of key, with its sequence on the vertices of the graph that `order` comes from.
+	// Returns false if there is none.
+	bool lookup(const Key &key, const std::vector<int> &order, Entry &res) const;
+	// Stores the bounds and the sequence (on the vertices of the graph `order` comes from)
+	// if they improve the entry.
+	void store(const Key &key, const std::vector<int> &order, int lb, int ub, const contr_seq &seq);
+
+	// Cache of the file $TINYWIDTH_CACHE, loaded once, or nullptr if it is not set.
+	static ComponentCache *installed();
+
+private:
+	std::map<Key, Entry> entries;
+	mutable std::mutex mutex;
+	std::ofstream file;
+
+	// Merges e into the entry of key: returns whether it improved
+	bool merge(const Key &key, Entry &&e);
+};
+
+namespace component_cache_detail
+{
+// FNV-1a, with two offset bases for the two halves of the hash
+struct Hasher
+{
+	uint64_t h1 = 0xcbf29ce484222325ULL, h2 = 0x84222325cbf29ce4ULL;
+
+	inline void add(uint64_t x)
+	{
+		for (int i = 0; i < 8; ++i, x >>= 8)
+		{
+			h1 = (h1 ^ (x & 0xff)) * 0x100000001b3ULL;
+			h2 = (h2 ^ (x & 0xff)) * 0x100000001b3ULL;
+		}
+	}
+};
+}
+
+template<class G>
+ComponentCache::Key ComponentCache::key(const G &g, std::vector<int> &order)
+{
+	std::vector<int> color;
+	std::vector<std::pair<std::vector<int>, int>> sig;
+	refinement_order(g, order, color, sig, COMPONENT_CACHE_ROUNDS);
+	int k = order.size();
+	std::vector<int> pos(g.n, -1);
+	for (int i = 0; i < k; ++i)
+		pos[order[i]] = i;
+
+	// Header, then the neighbors of each vertex after it, black as 2j and red as 2j + 1
+	component_cache_detail::Hasher h;
+	h.add(k);
+	h.add(g.full_width());
+	std::vector<int> nbs;
+	for (int i = 0; i < k; ++i)
+	{
+		nbs.clear();
+		for (int w: g.neighbors(order[i]))
+			if (pos[w] > i)
+				nbs.push_back(2 * pos[w]);
+		for (int w: g.red_neighbors(order[i]))
+			if (pos[w] > i)
+				nbs.push_back(2 * pos[w] + 1);
+		std::sort(nbs.begin(), nbs.end());
+		h.add(nbs.size());
+		for (int x: nbs)
+			h.add(x);
+	}
+	return Key(h.h1, h.h2, k);
+}
+
+// Width of seq on g, or -1 if it is not a full valid contraction sequence of g
+template<class G>
+int replay_width(G g, const contr_seq &seq)
+{
+	for (auto [u, v]: seq)
+	{
+		if (u < 0 || v < 0 || u >= g.n || v >= g.n || u == v || g.is_deleted(u) || g.is_deleted(v))
+			return -1;
+		g.merge(u, v, g.merge_cost(u, v));
+	}
+	return (g.actual_n() <= 1) ? g.full_width() : -1;
+}
+
+/*
+ * A component looked up in the cache of the current SolverContext (if any).
+ * The entry found is only kept if its sequence replays to its width on g,
+ * which guards against hash collisions and corrupted files.
+ */
+template<class G>
+class CachedComponent
+{
+public:
+	ComponentCache::Entry entry;
+	bool found = false;
+
+	explicit CachedComponent(const G &g);
+
+	// Whether the entry needs no more work: its width is optimal, or no larger than lb.
+	inline bool solved(int lb) const { return found && (entry.lb >= entry.ub || entry.ub <= lb); }
+	// Stores a sequence of g, of width ub, and a lower bound proven on g alone.
+	inline void store(int lb, int ub, const contr_seq &seq)
+	{
+		if (cache && ub < INFTY)
+			cache->store(key, order, lb, ub, seq);
+	}
+
+private:
+	ComponentCache *cache;
+	ComponentCache::Key key;
+	std::vector<int> order;
+};
+
+template<class G>
+CachedComponent<G>::CachedComponent(const G &g):
+	cache(SolverContext::current().component_cache)
+{
+	if (!cache)
+		return;
+	key = ComponentCache::key(g, order);
+	if (cache->lookup(key, order, entry) && replay_width(g, entry.seq) == entry.ub)
+	{
+		STAT_INC(component_cache_hits);
+		found = true;
+	}
+	else
+		entry = ComponentCache::Entry();
+}
@@ -0,0 +1,77 @@
+#include "context.h"
+#include "component_cache.h"
+
+#include <ostream>
+#include <streambuf>
+
+using namespace std;
+
+thread_local SolverContext *SolverContext::active = nullptr;
+
+SolverContext::SolverContext(uint64_t seed):
+	rng(seed),
+	component_cache(ComponentCache::installed())
+{
+}
+
+SolverContext SolverContext::worker(uint64_t seed, int threads) const
+{
+	SolverContext res(seed);
+	res.verbose = verbose;
+	res.params = params;
+	res.param_profile = param_profile;
+	res.component_cache = component_cache;
+	res.threads = threads;
+	return res;
+}
+
+void SolverContext::join_worker(const SolverContext &w)
+{
+	stats.add(w.stats);
+	run_stats.add(w.run_stats);
+}
+
+ostream &SolverContext::log()
+{
+	// Stream without buffer: all writes fail and are discarded.
+	thread_local ostream null_stream(nullptr);
+	return verbose ? cerr : null_stream;
+}
+
+SolverContext::Scope::Scope(SolverContext &ctx):
+	prev(active)
+{
+	active = &ctx;
+}
+
+SolverContext::Scope::~Scope()
+{
+	active = prev;
+}
+
+SolverContext &SolverContext::current()
+{
+	if (active == nullptr)
+	{
+		thread_local SolverContext default_ctx;
+		return default_ctx;
+	}
+	return *active;
+}
+
+SolveProfile &profile()
+{
+	return SolverContext::current().profile;
+}
+
+#ifdef TINYWIDTH_STATS
+SolverStats &stats()
+{
+	return SolverContext::current().stats;
+}
+
+SolverStats &run_stats()
+{
+	return SolverContext::current().run_stats;
+}
+#endif
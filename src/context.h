@@ -0,0 +1,85 @@
+#pragma once
+
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "bgraph.h"
+#include "params.h"
+#include "timing.h"
+#include "stats.h"
+#include "subgraph_cache.h"
+
+class ComponentCache;
+
+/*
+ * All the mutable state used while solving a graph:
+ * random generator, parameters, buffers of BitGraph::contract, profile, statistics and log.
+ *
+ * The solver functions use the context of the current thread (see Scope).
+ * Contexts can be reused across graphs, which avoids reallocating the buffers,
+ * and several contexts can run concurrently in different threads.
+ * When no context is active, each thread uses its own default context.
+ */
+class SolverContext
+{
+public:
+	explicit SolverContext(uint64_t seed = std::random_device()());
+
+	RNG rng;
+	SolveProfile profile;
+	SolverStats stats, run_stats;
+	bool verbose = true;
+	// Parameters of the graph being solved, selected from param_profile by solve()
+	SolverParams params;
+	ParamProfile param_profile = ParamProfile::installed();
+	// Results of subgraph_lb, kept across graphs: keys do not depend on the sampled graph
+	SubgraphCache lb_cache;
+	// Solved components, kept across runs (see ComponentCache), or nullptr
+	ComponentCache *component_cache;
+	// Number of threads the solver may run from this context
+	int threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+	// Context of a worker thread started from this one: same parameters, log and component cache,
+	// its own random generator and buffers, and `threads` threads.
+	// Its stats are added back by join_worker.
+	SolverContext worker(uint64_t seed, int threads) const;
+	void join_worker(const SolverContext &w);
+
+	// Buffer for a BitGraph with `k` + 1 vertices, used by BitGraph::contract.
+	inline BitGraph &level(int k)
+	{
+		if (k >= (int)levels.size())
+			levels.resize(k + 1, BitGraph(0));
+		return levels[k];
+	}
+
+	std::ostream &log();
+
+	// Makes `ctx` the context of the current thread during the lifetime of the scope.
+	class Scope
+	{
+	public:
+		explicit Scope(SolverContext &ctx);
+		~Scope();
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+	private:
+		SolverContext *prev;
+	};
+
+	static SolverContext &current();
+
+private:
+	std::vector<BitGraph> levels;
+	static thread_local SolverContext *active;
+};
+
+// Parameters of the current context.
+inline const SolverParams &params() { return SolverContext::current().params; }
+
+// Log of the current context, discarded when it is not verbose.
+inline std::ostream &solver_log() { return SolverContext::current().log(); }
@@ -0,0 +1,131 @@
+#include "first_merge_lb.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+#include "context.h"
+#include "params.h"
+#include "trace.h"
+
+using namespace std;
+
+int first_merge_lb(const Graph &g)
+{
+	TraceSpan span("first_merge_lb", "n", g.actual_n());
+	int floor = g.full_width();
+	if (g.actual_n() <= 1)
+		return floor;
+
+	// Ranks by (degree, vertex)
+	vector<int> order(g.vertices().begin(), g.vertices().end());
+	sort(order.begin(), order.end(), [&](int u, int v) {
+		return make_pair(g.total_deg(u), u) < make_pair(g.total_deg(v), v);
+	});
+	int k = order.size();
+	vector<int> rank(g.n, -1), deg(k);
+	for (int i = 0; i < k; ++i)
+	{
+		rank[order[i]] = i;
+		deg[i] = g.total_deg(order[i]);
+	}
+
+	// The neighbors of rank i are adj[start[i]..start[i + 1]), sorted, as 2 * rank for black edges
+	// and 2 * rank + 1 for red edges
+	vector<int> start(k + 1, 0), adj;
+	adj.reserve(accumulate(deg.begin(), deg.end(), 0LL));
+	for (int i = 0; i < k; ++i)
+	{
+		for (int w: g.neighbors(order[i]))
+			adj.push_back(2 * rank[w]);
+		for (int w: g.red_neighbors(order[i]))
+			adj.push_back(2 * rank[w] + 1);
+		start[i + 1] = adj.size();
+		sort(adj.begin() + start[i], adj.end());
+	}
+
+	// Hubs (the ranks from `hubs` on) are not used as middles of 2-paths, which would take deg^2 steps each.
+	// hub[i] counts the hub neighbors of rank i, last in its list: a pair (i, j) has at most
+	// min(hub[i], hub[j]) common neighbors left uncounted, and each lowers its cost by at most 2.
+	long long hub_deg = max<long long>(FIRST_MERGE_HUB_DEG, sqrt((double)adj.size()));
+	int hubs = upper_bound(deg.begin(), deg.end(), hub_deg) - deg.begin();
+	vector<int> hub(k), free_deg(k);
+	for (int i = 0; i < k; ++i)
+	{
+		hub[i] = adj.begin() + start[i + 1] - lower_bound(adj.begin() + start[i], adj.begin() + start[i + 1], 2 * hubs);
+		free_deg[i] = deg[i] - hub[i];
+	}
+
+	// A pair that is neither adjacent nor shares a neighbor (other than hubs) creates at least
+	// deg(u) + deg(v) - 2 min(hub(u), hub(v)) >= free_deg(u) + free_deg(v) red edges
+	partial_sort(free_deg.begin(), free_deg.begin() + 2, free_deg.end());
+	atomic<int> best = free_deg[0] + free_deg[1];
+	atomic<int> next = 0;
+	auto worker = [&] {
+		// all[j] and black[j] count the common neighbors of i and j (black ones for both edges in black)
+		vector<int> all(k, 0), black(k, 0);
+		vector<char> adjacent(k, 0);
+		vector<int> touched;
+		for (int i = next++; i < k; i = next++)
+		{
+			int b = best.load(memory_order_relaxed);
+			if (b <= floor)
+				break;
+			// cost(i, j) >= deg(j) - deg(i) - 1: j cannot beat b if its degree is larger than this
+			long long max_deg = (long long)deg[i] + b;
+
+			for (int p = start[i]; p < start[i + 1] - hub[i]; ++p)
+			{
+				int w = adj[p] >> 1;
+				bool black_iw = !(adj[p] & 1);
+				// Neighbors of w of rank > i
+				auto it = upper_bound(adj.begin() + start[w], adj.begin() + start[w + 1], 2 * i + 1);
+				for (; it != adj.begin() + start[w + 1]; ++it)
+				{
+					int j = *it >> 1;
+					if (deg[j] > max_deg)
+						break;
+					if (all[j]++ == 0)
+						touched.push_back(j);
+					if (black_iw && !(*it & 1))
+						++black[j];
+				}
+			}
+			for (int p = start[i]; p < start[i + 1]; ++p)
+			{
+				int j = adj[p] >> 1;
+				adjacent[j] = 1;
+				if (j > i && deg[j] <= max_deg && all[j] == 0)
+					touched.push_back(j);
+			}
+
+			int local = b;
+			for (int j: touched)
+			{
+				local = min(local, deg[i] + deg[j] - 2 * adjacent[j] - all[j] - black[j] - 2 * min(hub[i], hub[j]));
+				all[j] = black[j] = 0;
+			}
+			for (int p = start[i]; p < start[i + 1]; ++p)
+				adjacent[adj[p] >> 1] = 0;
+			touched.clear();
+
+			for (int cur = best.load(); local < cur && !best.compare_exchange_weak(cur, local);)
+				;
+		}
+	};
+
+	int threads = max(1, min(SolverContext::current().threads, k / 1024));
+	if (threads == 1)
+		worker();
+	else
+	{
+		vector<thread> pool;
+		for (int t = 0; t < threads; ++t)
+			pool.emplace_back(worker);
+		for (auto &th: pool)
+			th.join();
+	}
+	return max(floor, best.load());
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "common.h"
+#include "graph.h"
+
+/*
+ * Lower bound from the first contraction of any sequence: merging u and v creates a vertex
+ * with red degree |(N(u) \cup N(v)) \ {u, v}| minus the common black neighbors of u and v
+ * (N counts black and red neighbors), so the twin-width is at least the minimum over all pairs.
+ *
+ * Unlike greedy_lb, which tries the n^2 pairs, only the pairs that are adjacent or have a common
+ * neighbor are counted, by enumerating the paths u - w - v in a CSR layout, in parallel over u.
+ * The other pairs cost at least the sum of the two smallest degrees.
+ * Vertices are ranked by degree, so that each pair is counted once from its endpoint of lower degree
+ * and the paths to much larger degrees (which cannot beat the best pair so far) are cut.
+ * Vertices of very large degree (hubs, see FIRST_MERGE_HUB_DEG) are not used as middles of paths,
+ * so that a hub does not cost deg^2 steps: the cost of each pair is lowered by the common hub neighbors
+ * it may have, which keeps the bound valid and the work at O(m sqrt(m)).
+ * It runs on the threads of the current SolverContext.
+ *
+ * The result is at least g.full_width().
+ */
+int first_merge_lb(const Graph &g);
@@ -1,6 +1,9 @@
 #include "graph.h"
 
+#include "trace.h"
+
 #include <cassert>
+#include <climits>
 #include <unordered_map>
 #include <stack>
 
@@ -108,6 +111,7 @@ void Graph::erase(int u)
 /*************** Parsing Graphs ***************/
 Graph Graph::from_istream(istream &is)
 {
+	TraceSpan span("Graph::from_istream");
 	string a;
 	int n, m;
 	is >> a >> a >> n >> m;
@@ -123,6 +127,48 @@ Graph Graph::from_istream(istream &is)
 	return res;
 }
 
+bool Graph::parse(istream &is, Graph &res, string &error)
+{
+	TraceSpan span("Graph::parse");
+	string p, tww;
+	long long n, m;
+	if (!(is >> p >> tww >> n >> m) || p != "p" || n < 0 || m < 0 || n > INT_MAX)
+	{
+		error = "bad header";
+		return false;
+	}
+	Graph g(n);
+	for (long long i = 0; i < m; ++i)
+	{
+		long long u, v;
+		if (!(is >> u >> v))
+		{
+			error = "missing edges (" + to_string(i) + " of " + to_string(m) + " read)";
+			return false;
+		}
+		if (u < 1 || u > n || v < 1 || v > n)
+		{
+			error = "edge " + to_string(u) + " " + to_string(v) + " out of range";
+			return false;
+		}
+		if (u != v)
+			g.add_edge(u - 1, v - 1);
+	}
+	res = move(g);
+	return true;
+}
+
+// Edges are 0-indexed, self-loops are ignored.
+Graph Graph::from_edges(int n, const contr_seq &edges)
+{
+	Graph res(n);
+	for (auto [u, v]: edges)
+		if (u != v)
+			res.add_edge(u, v);
+
+	return res;
+}
+
 BitGraph Graph::subgraph(const Si& vx) const
 {
 	vector<int> m_inv(n);
@@ -133,6 +179,59 @@ BitGraph Graph::subgraph(const Si& vx) const
 	return dense_subgraph(vx, m_inv);
 }
 
+vector<vector<int>> Graph::connected_components() const
+{
+	vector<vector<int>> res;
+	vector<bool> visited(n, false);
+	stack<int> to_visit;
+	for (int u: vertices())
+	{
+		if (visited[u])
+			continue;
+		res.emplace_back();
+		to_visit.push(u);
+		visited[u] = true;
+		while (!to_visit.empty())
+		{
+			int v = to_visit.top();
+			to_visit.pop();
+			res.back().push_back(v);
+			for (const Si *nbs: {&adj[v], &red_adj[v]})
+				for (int w: *nbs)
+					if (!visited[w])
+					{
+						visited[w] = true;
+						to_visit.push(w);
+					}
+		}
+		sort(res.back().begin(), res.back().end());
+	}
+	return res;
+}
+
+Graph Graph::induced_subgraph(const vector<int> &vx) const
+{
+	vector<int> m_inv(n, -1);
+	for (size_t i = 0; i < vx.size(); ++i)
+		m_inv[vx[i]] = i;
+
+	Graph res(vx.size());
+	res.full_tww = full_tww;
+	for (size_t i = 0; i < vx.size(); ++i)
+	{
+		for (int v: adj[vx[i]])
+			if (m_inv[v] > (int)i)
+				res.add_edge(i, m_inv[v]);
+		for (int v: red_adj[vx[i]])
+			if (m_inv[v] > (int)i)
+			{
+				res.red_adj[i].insert(m_inv[v]);
+				res.red_adj[m_inv[v]].insert(i);
+			}
+	}
+	return res;
+}
+
 int Graph::largest_cc_size() const
 {
     vector<bool> visited(n, false);
@@ -43,11 +43,18 @@ public:
 	contr_seq kernelize_heur();
 
 	static Graph from_istream(std::istream &is);
+	// Like from_istream, but checks the header and the edges:
+	// returns false, with a message in error, if they are missing or out of range.
+	static bool parse(std::istream &is, Graph &res, std::string &error);
+	static Graph from_edges(int n, const contr_seq &edges);
 	inline static Graph from_file(const std::string &fname) { std::ifstream ifs(fname); return from_istream(ifs); }
 	inline static Graph from_cin() { return from_istream(std::cin); }
 
 
-	std::vector<std::pair<std::vector<int>, BitGraph>> connected_components() const;
+	// Vertex sets of the connected components (black and red edges), each one sorted.
+	std::vector<std::vector<int>> connected_components() const;
+	// The trigraph induced by vx, where vertex i is vx[i]. The full width is kept.
+	Graph induced_subgraph(const std::vector<int> &vx) const;
 	BitGraph subgraph(const Si& vx) const;
 	BitGraph dense_subgraph(const Si& vx, const std::vector<int> &m_inv) const;
     int largest_cc_size() const;
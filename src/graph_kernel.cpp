@@ -5,12 +5,14 @@
 #include <unordered_map>
 
 #include "union_find.hpp"
+#include "trace.h"
 
 using namespace std;
 
 /******* Kernelization ********/
 void Graph::kernelize_safe()
 {
+	TraceSpan span("kernelize_safe", "n", actual_n());
 	merge_twins();
 }
 
@@ -1,10 +1,19 @@
 #include "large_graphs.h"
 
+#include <chrono>
 #include <iostream>
 
 #include "bab.h"
+#include "component_cache.h"
+#include "first_merge_lb.h"
+#include "neighborhood_lsh.h"
 #include "upper_bound.h"
 #include "lower_bound.h"
+#include "lb_sampling.h"
+#include "local_search.h"
+#include "timing.h"
+#include "stats.h"
+#include "trace.h"
 
 using namespace std;
 
@@ -18,18 +27,24 @@ pair<int, int> random_neighbors(int x, const Graph &g, RNG &rng)
 	return make_pair(res[0], res[1]);
 }
 
-pair<int, contr_seq> close_merge_sparse(const Graph &g_init, RNG &rng, int outer_it, int inner_it)
+pair<int, contr_seq> close_merge_sparse(const Graph &g_init, RNG &rng, int outer_it, int inner_it, int cutoff = INFTY)
 {
+	TraceSpan span("close_merge_sparse", "outer_it", outer_it);
 	contr_seq best_sol;
 	int best_cost = INFTY;
+	// Each restart starts from a copy of the index of g_init, which is cheaper than hashing every edge again
+	const NeighborhoodLSH lsh_init(g_init, rng);
 
 	for (int oit = 0; oit < outer_it; ++oit)
 	{
+		STAT_INC(heur_restarts);
 		auto g = g_init;
 		contr_seq cur_sol;
+		NeighborhoodLSH lsh = lsh_init;
+		int bound = min(best_cost, cutoff);
 
 		vector<int> deg_gt_2;
-		while (g.actual_n() > 1)
+		while (g.actual_n() > 1 && g.full_width() < bound)
 		{
 			deg_gt_2.clear();
 			for (int u: g.vertices())
@@ -74,7 +89,10 @@ pair<int, contr_seq> close_merge_sparse(const Graph &g_init, RNG &rng, int outer
 			for (int i = 0; i < inner_it; ++i)
 			{
 				int x = random_from(deg_gt_2, rng);
-				auto [u, v] = random_neighbors(x, g, rng);
+				// Every other try, pair x with a vertex of similar neighborhood
+				// instead of merging two of its neighbors
+				int y = (i % 2 == 0) ? lsh.candidate(x, rng) : -1;
+				auto [u, v] = (y >= 0) ? make_pair(x, y) : random_neighbors(x, g, rng);
 
 				auto tmp_hint = g.merge_cost(u, v);
 				if (best_uv.first == -1 || tmp_hint.size() < best_hint.size())
@@ -84,15 +102,18 @@ pair<int, contr_seq> close_merge_sparse(const Graph &g_init, RNG &rng, int outer
 				}
 			}
 			
-			g.merge(best_uv.first, best_uv.second, move(best_hint));
+			lsh.merge(g, best_uv.first, best_uv.second, move(best_hint));
 			cur_sol.push_back(best_uv);
 
 			// auto tmp = g.kernelize();
 			// cur_sol.insert(cur_sol.end(), tmp.begin(), tmp.end());
 		}
-	
-		if (g.full_width() < best_cost)
+
+		if (g.full_width() >= bound)
+			STAT_INC(heur_aborts);
+		else
 		{
+			STAT_INC(heur_improvements);
 			best_cost = g.full_width();
 			best_sol = move(cur_sol);
 		}
@@ -102,34 +123,96 @@ pair<int, contr_seq> close_merge_sparse(const Graph &g_init, RNG &rng, int outer
 }
 
 // Large graph heuristics
-pair<int, contr_seq> best_heur_sparse(const Graph &g)
+pair<int, contr_seq> best_heur_sparse(const Graph &g, int cutoff = INFTY)
 {
-	static random_device rd;
-	static RNG rng(rd());
+	TraceSpan span("best_heur_sparse", "n", g.actual_n());
+	RNG &rng = SolverContext::current().rng;
 
-	auto &&res = close_merge_sparse(g, rng, DEFAULT_OUTER_SP, DEFAULT_INNER_SP);
+	auto &&res = close_merge_sparse(g, rng, params().outer_sp, params().inner_sp, cutoff);
 	// auto &&res2 = greedy_mincost_local(g);
 	return res;
 	// return min(res, res2);
 }
 
 
-contr_seq solve_large(const Graph &g)
+contr_seq solve_large(const Graph &g, int lb0, int budget_n)
 {
-	pair<int, contr_seq> ub = best_heur_sparse(g);
-	int lb_size = 25;
-	int lb = subgraph_lb(g, lb_size);
+	TraceSpan span("solve_large", "n", g.actual_n());
+	auto timed_ub = [&](int cutoff) {
+		PhaseTimer t(Phase::Upper);
+		return best_heur_sparse(g, cutoff);
+	};
+	// Samples rotate between the strategies of LbSampler,
+	// so that the dense cores of the graph are hit early.
+	LbSampler<Graph> sampler = [&] {
+		PhaseTimer t(Phase::Lower);
+		return LbSampler<Graph>(g);
+	}();
+	int lb_round = 0;
+	auto timed_lb = [&](int k, int prev_lb) {
+		PhaseTimer t(Phase::Lower);
+		auto strategy = (LbStrategy)(lb_round++ % (int)LbStrategy::Count);
+		return sampler.lb(strategy, k, prev_lb, SolverContext::current().rng);
+	};
+
+	// A component solved by a previous run is used as is,
+	// and otherwise its cached bounds seed the search
+	CachedComponent<Graph> cached(g);
+	if (cached.solved(lb0))
+	{
+		solver_log() << "n: " << g.actual_n() << ", cached: " << cached.entry.ub << endl;
+		profile().lb = max(lb0, cached.entry.lb);
+		profile().ub = cached.entry.ub;
+		stats_component(0, g.actual_n(), cached.entry.ub, profile().lb, cached.entry.ub);
+		return cached.entry.seq;
+	}
+
+	pair<int, contr_seq> ub(cached.entry.ub, cached.entry.seq);
+	ub = min(ub, timed_ub(ub.first));
+	// The first contraction gives a bound before any sampling
+	int merge_lb = [&] {
+		PhaseTimer t(Phase::Lower);
+		return first_merge_lb(g);
+	}();
+	solver_log() << "n: " << g.actual_n() << ", first merge lb: " << merge_lb << endl;
+	int lb_size = params().lb_k;
+	// own_lb only counts the bounds proven on g: a sample does better than the bound it is given
+	int own_lb = max(merge_lb, cached.entry.lb);
+	auto sampled_lb = [&](int prev_lb) {
+		int x = timed_lb(lb_size, prev_lb);
+		if (x > prev_lb)
+			own_lb = max(own_lb, x);
+		return x;
+	};
+	int lb = max({lb0, cached.entry.lb, merge_lb});
+	if (ub.first > lb)
+		lb = max(lb, sampled_lb(lb));
+	// The local search of the component has time proportional to its size, shared by the rounds below
+	if (budget_n <= 0)
+		budget_n = g.actual_n();
+	double ls_left = params().ls_time_s() * g.actual_n() / budget_n;
 	while (ub.first > lb)
 	{
-		cerr 
+		solver_log()
 			<< "ub: " << ub.first
 			<< ", lb: " << lb
 			<< ", lb_size: " << lb_size
 			<< endl;
-		ub = min(ub, best_heur_sparse(g));
-		lb = max(lb, subgraph_lb(g, lb_size, lb));
+		ub = min(ub, timed_ub(ub.first));
+		lb = max(lb, sampled_lb(lb));
+		if (ub.first > lb && g.actual_n() <= LS_MAX_N_SPARSE && ls_left > 0)
+		{
+			PhaseTimer t(Phase::Upper);
+			auto start = chrono::steady_clock::now();
+			ub = local_search(g, ub, lb, ls_left);
+			ls_left -= chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		}
 		lb_size = min(lb_size + 1, BitGraph::VxContainer::MAX_SIZE);
 	}
 
+	cached.store(own_lb, ub.first, ub.second);
+	profile().lb = lb;
+	profile().ub = ub.first;
+	stats_component(0, g.actual_n(), ub.first, lb, ub.first);
 	return ub.second;
 }
\ No newline at end of file
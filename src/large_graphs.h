@@ -3,4 +3,7 @@
 #include "common.h"
 #include "graph.h"
 
-contr_seq solve_large(const Graph &g);
+// Heuristic solution for graphs too large for the dense engine,
+// improved until it matches the lower bound (or lb0, a lower bound known from elsewhere).
+// budget_n is the number of vertices the time of the local search is shared with (g alone if 0).
+contr_seq solve_large(const Graph &g, int lb0 = 0, int budget_n = 0);
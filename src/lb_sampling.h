@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "common.h"
+#include "lower_bound.h"
+#include "upper_bound.h"
+#include "trace.h"
+
+/*
+ * Samplers for subgraph_lb that target the hard parts of a large graph.
+ *
+ * A uniform random seed rarely lands in the small dense cores that carry the twin-width
+ * of a large sparse graph. LbSampler precomputes, once per graph:
+ *  - the core number of every vertex (Batagelj-Zaversnik bucket peeling);
+ *  - the densest subgraph found along the same peeling order (Charikar's 2-approximation);
+ *  - a twin score: the smallest symmetric difference between the neighborhood of a vertex
+ *    and the one of any other vertex. A vertex with a high score has no cheap merge.
+ * Each strategy draws its seed among the best vertices for its measure,
+ * and biases the growth of the sample towards them.
+ */
+enum class LbStrategy {Random, Core, Dense, Twin, Count};
+
+template <class T>
+class LbSampler
+{
+public:
+	explicit LbSampler(const T &g): g(g)
+	{
+		TraceSpan span("LbSampler", "n", g.actual_n());
+		compute_cores();
+		compute_twin_scores();
+	}
+
+	typename T::VxContainer sample(LbStrategy strategy, int k, RNG &rng) const
+	{
+		switch (strategy)
+		{
+		case LbStrategy::Core:
+			return grow_sample(g, random_from(top_core, rng), k,
+				[&](int u) { return (float)core[u]; }, rng);
+		case LbStrategy::Dense:
+			return grow_sample(g, random_from(dense, rng), k,
+				[&](int u) { return (float)in_dense[u]; }, rng);
+		case LbStrategy::Twin:
+			return grow_sample(g, random_from(top_twin, rng), k,
+				[&](int u) { return 2.0f * twin_score[u] / (max_twin_score + 1); }, rng);
+		default:
+			return grow_sample(g, random_from(vertices, rng), k,
+				[](int) { return 0.0f; }, rng);
+		}
+	}
+
+	int lb(LbStrategy strategy, int k, int prev_lb, RNG &rng) const
+	{
+		TraceSpan span("sampled_lb", "strategy", (int)strategy);
+		return sample_lb(g, sample(strategy, k, rng), prev_lb);
+	}
+
+private:
+	// Neighbors with a larger degree are skipped when looking for near-twins,
+	// so that hubs do not make the twin scores quadratic.
+	static constexpr int TWIN_MAX_DEG = 256;
+
+	const T &g;
+	std::vector<int> vertices;
+	std::vector<int> core;
+	std::vector<char> in_dense;
+	std::vector<int> twin_score;
+	int max_twin_score = 0;
+	// Seeds of each strategy
+	std::vector<int> top_core, dense, top_twin;
+
+	void compute_cores()
+	{
+		for (int u: g.vertices())
+			vertices.push_back(u);
+
+		int max_deg = 0;
+		std::vector<int> deg(g.n, 0);
+		long long edges = 0;
+		for (int u: vertices)
+		{
+			deg[u] = g.total_deg(u);
+			max_deg = std::max(max_deg, deg[u]);
+			edges += deg[u];
+		}
+		edges /= 2;
+
+		// Bucket sort of the vertices by degree
+		std::vector<int> bin(max_deg + 2, 0), pos(g.n), order(vertices.size());
+		for (int u: vertices)
+			++bin[deg[u] + 1];
+		for (int d = 1; d <= max_deg + 1; ++d)
+			bin[d] += bin[d - 1];
+		for (int u: vertices)
+		{
+			pos[u] = bin[deg[u]]++;
+			order[pos[u]] = u;
+		}
+		for (int d = max_deg; d > 0; --d)
+			bin[d] = bin[d - 1];
+		bin[0] = 0;
+
+		// Peel a vertex of minimum degree at each step.
+		// The remaining graph after the step of best density is the densest subgraph found.
+		// deg is clamped to the current core number, rem is the actual degree in the remaining graph.
+		std::vector<int> rem = deg;
+		std::vector<char> removed(g.n, 0);
+		core.assign(g.n, 0);
+		double best_density = -1;
+		size_t best_step = 0;
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			double density = (double)edges / (order.size() - i);
+			if (density > best_density)
+			{
+				best_density = density;
+				best_step = i;
+			}
+
+			int u = order[i];
+			core[u] = deg[u];
+			edges -= rem[u];
+			removed[u] = 1;
+			auto peel = [&](int w) {
+				if (!removed[w])
+					--rem[w];
+				if (deg[w] <= deg[u])
+					return;
+				// Move w to the start of its bucket, then shrink the bucket
+				int dw = deg[w], pw = pos[w], ps = bin[dw], s = order[ps];
+				if (s != w)
+				{
+					std::swap(order[pw], order[ps]);
+					pos[s] = pw;
+					pos[w] = ps;
+				}
+				++bin[dw];
+				--deg[w];
+			};
+			for (int w: g.neighbors(u))
+				peel(w);
+			for (int w: g.red_neighbors(u))
+				peel(w);
+		}
+
+		in_dense.assign(g.n, 0);
+		for (size_t i = best_step; i < order.size(); ++i)
+		{
+			in_dense[order[i]] = 1;
+			dense.push_back(order[i]);
+		}
+
+		int max_core = 0;
+		for (int u: vertices)
+			max_core = std::max(max_core, core[u]);
+		for (int u: vertices)
+			if (core[u] == max_core)
+				top_core.push_back(u);
+	}
+
+	void compute_twin_scores()
+	{
+		int min_deg = INFTY;
+		for (int u: vertices)
+			min_deg = std::min(min_deg, g.total_deg(u));
+
+		// common[v]: number of neighbors shared by u and v, over the neighbors of u of degree <= TWIN_MAX_DEG
+		std::vector<int> common(g.n, 0), touched;
+		twin_score.assign(g.n, 0);
+		for (int u: vertices)
+		{
+			touched.clear();
+			auto visit = [&](int w) {
+				if (g.total_deg(w) > TWIN_MAX_DEG)
+					return;
+				auto count = [&](int v) {
+					if (v == u)
+						return;
+					if (common[v]++ == 0)
+						touched.push_back(v);
+				};
+				for (int v: g.neighbors(w))
+					count(v);
+				for (int v: g.red_neighbors(w))
+					count(v);
+			};
+			for (int w: g.neighbors(u))
+				visit(w);
+			for (int w: g.red_neighbors(u))
+				visit(w);
+
+			// Vertices that share no neighbor with u are at distance deg(u) + deg(v)
+			int du = g.total_deg(u);
+			int best = du + min_deg;
+			for (int v: touched)
+			{
+				bool adj = g.adjacent(u, v);
+				int diff = (du - adj) + (g.total_deg(v) - adj) - 2 * common[v];
+				best = std::min(best, diff);
+				common[v] = 0;
+			}
+			twin_score[u] = best;
+			max_twin_score = std::max(max_twin_score, best);
+		}
+
+		// Seeds: the 5% of vertices with the highest score
+		top_twin = vertices;
+		size_t top = std::max<size_t>(1, vertices.size() / 20);
+		std::nth_element(top_twin.begin(), top_twin.begin() + (top - 1), top_twin.end(),
+			[&](int a, int b) { return twin_score[a] > twin_score[b]; });
+		top_twin.resize(top);
+	}
+};
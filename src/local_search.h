@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "common.h"
+#include "context.h"
+#include "params.h"
+#include "stats.h"
+#include "trace.h"
+
+/*
+ * Simulated annealing over contraction sequences, starting from a heuristic solution.
+ *
+ * Moves on a sequence of k contractions (u, v) (v is merged into u):
+ *  - re-pair: replace u by another vertex alive at that step, close to v if possible;
+ *  - block: move a few consecutive contractions earlier or later (rejected if the
+ *    sequence becomes invalid);
+ *  - swap: exchange survivor and victim, renaming u to v in the rest of the sequence.
+ *    The trigraphs are the same up to labels: the width does not change,
+ *    but later re-pairs see different vertices alive.
+ *
+ * The energy is the width W, plus the mean of (d / (W + 1))^2 over the contractions,
+ * where d is the red degree of the survivor: this is in [0, 1), and breaks the plateaus
+ * of equal width by favoring sequences that stay away from W.
+ * The trigraph is saved every `stride` contractions: a move at step i is evaluated by
+ * replaying from the last checkpoint before i, and the replay stops as soon as
+ * the energy of the prefix (a lower bound of the final energy) exceeds what the acceptance test could accept.
+ * An accepted move at step i only makes the checkpoints after i stale: they are rebuilt
+ * by the next replays that go through them, before their first changed step.
+ * A move thus copies the trigraph once, plus the checkpoints rebuilt since the last accepted move.
+ */
+template <class G>
+class LocalSearch
+{
+public:
+	LocalSearch(const G &g, const contr_seq &start, RNG &rng):
+		g0(g), rng(rng), seq(start), k(start.size())
+	{
+		stride = std::max(1, (k + LS_CHECKPOINTS - 1) / LS_CHECKPOINTS);
+		ckpts.push_back(g0);
+		prefix.emplace_back(g0.full_width(), 0);
+		death.resize(g.n);
+
+		// Full evaluation of the initial sequence, which builds all the checkpoints
+		energy = replay(seq, k, INFTY);
+		commit(k);
+		best_width = width;
+		best_seq = seq;
+	}
+
+	std::pair<int, contr_seq> run(int lb, double seconds)
+	{
+		using namespace std::chrono;
+		auto start = steady_clock::now();
+		std::uniform_real_distribution unif(0.0, 1.0);
+		contr_seq cand;
+		while (k > 1 && best_width > lb)
+		{
+			double t = duration<double>(steady_clock::now() - start).count() / seconds;
+			if (t >= 1)
+				break;
+			double temp = LS_T0 * std::pow(LS_T1 / LS_T0, t);
+
+			cand = seq;
+			int first = propose(cand);
+			if (first < 0)
+				continue;
+
+			double threshold = energy - temp * std::log(std::max(unif(rng), 1e-300));
+			double e = replay(cand, first, threshold);
+			if (e <= threshold)
+			{
+				seq.swap(cand);
+				energy = e;
+				commit(first);
+				if (width < best_width)
+				{
+					STAT_INC(heur_improvements);
+					best_width = width;
+					best_seq = seq;
+				}
+			}
+		}
+		return std::make_pair(best_width, best_seq);
+	}
+
+private:
+	const G &g0;
+	RNG &rng;
+	contr_seq seq, best_seq;
+	int k, stride;
+	double energy;
+	int width, best_width;
+
+	// ckpts[c] is the trigraph after c * stride contractions of seq,
+	// and prefix[c] the width and sum of the squared red degrees up to there.
+	// Only the ones up to index up_to_date are current.
+	std::vector<G> ckpts;
+	std::vector<std::pair<int, long long>> prefix;
+	int up_to_date = 0;
+	int replay_width = 0;
+	// death[x] is the step at which x is merged into another vertex (k if never)
+	std::vector<int> death;
+	G g = g0;
+
+	// Replays s, which is seq up to step `first`, from the last current checkpoint before `first`,
+	// and rebuilds the stale checkpoints on the way to `first`.
+	// Returns the energy, or INFTY if it exceeds threshold.
+	double replay(const contr_seq &s, int first, double threshold)
+	{
+		int c = std::min(first / stride, up_to_date);
+		g = ckpts[c];
+		auto [w, sum] = prefix[c];
+		for (int i = c * stride; i < k; ++i)
+		{
+			if (i % stride == 0 && i / stride > up_to_date && i <= first)
+				save(i / stride, w, sum);
+			auto [u, v] = s[i];
+			g.merge(u, v, g.merge_cost(u, v));
+			w = std::max(w, g.full_width());
+			sum += (long long)g.red_deg(u) * g.red_deg(u);
+			// The energy can only grow from here (the sum term stays below 1)
+			if (w + sum / ((double)k * (w + 1) * (w + 1)) > threshold)
+				return INFTY;
+		}
+		replay_width = w;
+		return w + sum / ((double)k * (w + 1) * (w + 1));
+	}
+
+	void save(int c, int w, long long sum)
+	{
+		if (c == (int)ckpts.size())
+		{
+			ckpts.push_back(g);
+			prefix.emplace_back(w, sum);
+		}
+		else
+		{
+			ckpts[c] = g;
+			prefix[c] = {w, sum};
+		}
+		up_to_date = c;
+	}
+
+	// Makes the last replay, of a sequence that differs from step `first`, the current one
+	void commit(int first)
+	{
+		up_to_date = std::min(up_to_date, first / stride);
+		width = replay_width;
+		compute_death();
+	}
+
+	void compute_death()
+	{
+		std::fill(death.begin(), death.end(), k);
+		for (int i = 0; i < k; ++i)
+			death[seq[i].second] = i;
+	}
+
+	bool valid(const contr_seq &s) const
+	{
+		std::vector<bool> dead(g0.n, false);
+		for (auto [u, v]: s)
+		{
+			if (u == v || dead[u] || dead[v])
+				return false;
+			dead[v] = true;
+		}
+		return true;
+	}
+
+	// A random vertex alive at step i, other than v and u
+	int alive_partner(int i, int u, int v)
+	{
+		std::uniform_int_distribution<int> unif(0, g0.n - 1);
+		// Prefer the neighbors of v in the last checkpoint before step i
+		if (rng() % 2 == 0)
+		{
+			const G &h = ckpts[std::min(i / stride, up_to_date)];
+			std::vector<int> nbs;
+			for (int w: h.neighbors(v))
+				if (death[w] > i && w != u)
+					nbs.push_back(w);
+			for (int w: h.red_neighbors(v))
+				if (death[w] > i && w != u)
+					nbs.push_back(w);
+			if (!nbs.empty())
+				return nbs[rng() % nbs.size()];
+		}
+		for (int tries = 0; tries < 32; ++tries)
+		{
+			int w = unif(rng);
+			if (w != u && w != v && !g0.is_deleted(w) && death[w] > i)
+				return w;
+		}
+		return -1;
+	}
+
+	// Applies a random move to s, and returns the first step changed,
+	// or -1 if no move was possible.
+	int propose(contr_seq &s)
+	{
+		std::uniform_int_distribution<int> step(0, k - 1);
+		int kind = rng() % 8;
+		if (kind < 5)
+		{
+			int i = step(rng);
+			auto [u, v] = s[i];
+			int w = alive_partner(i, u, v);
+			if (w < 0)
+				return -1;
+			s[i].first = w;
+			return i;
+		}
+		else if (kind < 7)
+		{
+			int len = 1 + rng() % std::min(k, LS_MAX_BLOCK);
+			int a = rng() % (k - len + 1);
+			int shift = (int)(rng() % (2 * LS_MAX_SHIFT + 1)) - LS_MAX_SHIFT;
+			int b = std::clamp(a + shift, 0, k - len);
+			if (b == a)
+				return -1;
+			if (b < a)
+				std::rotate(s.begin() + b, s.begin() + a, s.begin() + a + len);
+			else
+				std::rotate(s.begin() + a, s.begin() + a + len, s.begin() + b + len);
+			if (!valid(s))
+				return -1;
+			return std::min(a, b);
+		}
+		else
+		{
+			int i = step(rng);
+			auto [u, v] = s[i];
+			s[i] = {v, u};
+			for (int j = i + 1; j < k; ++j)
+			{
+				if (s[j].first == u)
+					s[j].first = v;
+				if (s[j].second == u)
+					s[j].second = v;
+			}
+			return i;
+		}
+	}
+};
+
+/*
+ * Improves `start`, a solution of g, for at most `seconds`,
+ * or until its width reaches lb.
+ */
+template <class G>
+std::pair<int, contr_seq> local_search(const G &g, const std::pair<int, contr_seq> &start, int lb, double seconds,
+									   RNG &rng = SolverContext::current().rng)
+{
+	TraceSpan span("local_search", "n", g.actual_n());
+	if (start.first <= lb || start.second.size() < 2)
+		return start;
+
+	LocalSearch<G> ls(g, start.second, rng);
+	auto res = ls.run(lb, seconds);
+	return std::min(res, start);
+}
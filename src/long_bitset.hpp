@@ -5,6 +5,198 @@
 #include <iterator>
 #include <immintrin.h>
 #include <array>
+#include <type_traits>
+#include <utility>
+
+template<int N>
+class LongBitset;
+
+/*
+ * Lazily evaluated bitset expressions.
+ * `a | b | (c ^ d)` builds a tree of small nodes instead of full temporaries,
+ * and the whole tree is evaluated in a single pass over the operands:
+ * lane by lane (256 bits) when stored into a LongBitset or tested with empty() and <=,
+ * and word by word (64 bits) for size(), contains() and iteration.
+ *
+ * Named LongBitsets are held by reference, so an expression
+ * must not outlive the bitsets it was built from.
+ * Temporary bitsets and sub-expressions are held by value.
+ */
+namespace bitset_expr
+{
+	template<class T>
+	concept Operand = requires(const T &e, int i)
+	{
+		T::LANES;
+		e.lane(i);
+		e.word(i);
+	};
+
+	template<class T>
+	struct IsBitset : std::false_type { };
+	template<int N>
+	struct IsBitset<LongBitset<N>> : std::true_type { };
+
+	template<class T>
+	using Held = std::conditional_t<std::is_lvalue_reference_v<T> && IsBitset<std::remove_cvref_t<T>>::value,
+									const std::remove_cvref_t<T>&, std::remove_cvref_t<T>>;
+
+	struct And
+	{
+		static inline __m256i lane(__m256i l, __m256i r) { return _mm256_and_si256(l, r); }
+		static inline uint64_t word(uint64_t l, uint64_t r) { return l & r; }
+	};
+
+	struct Or
+	{
+		static inline __m256i lane(__m256i l, __m256i r) { return _mm256_or_si256(l, r); }
+		static inline uint64_t word(uint64_t l, uint64_t r) { return l | r; }
+	};
+
+	struct Xor
+	{
+		static inline __m256i lane(__m256i l, __m256i r) { return _mm256_xor_si256(l, r); }
+		static inline uint64_t word(uint64_t l, uint64_t r) { return l ^ r; }
+	};
+
+	struct AndNot
+	{
+		// For some reason, "andnot(x, y)" computes ~x & y
+		static inline __m256i lane(__m256i l, __m256i r) { return _mm256_andnot_si256(r, l); }
+		static inline uint64_t word(uint64_t l, uint64_t r) { return l & ~r; }
+	};
+
+	// Iterates over the bits set in an expression, evaluating one word at a time.
+	template<class E>
+	class Iterator
+	{
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type        = int;
+		using difference_type   = int;
+		using reference         = int;
+
+		reference operator*() const { return w * 64 + std::countr_zero(cur); }
+		Iterator& operator++() { cur &= cur - 1; skip(); return *this; }
+		Iterator operator++(int) { Iterator tmp = *this; ++(*this); return tmp; }
+		friend bool operator== (const Iterator& a, const Iterator& b) { return a.w == b.w && a.cur == b.cur; };
+		friend bool operator!= (const Iterator& a, const Iterator& b) { return !(a == b); };
+
+		Iterator(const E *e, int w) : e(e), w(w), cur(w < WORDS ? e->word(w) : 0) { skip(); }
+
+	private:
+		static constexpr int WORDS = 4 * E::LANES;
+		const E *e;
+		int w;
+		uint64_t cur;
+
+		void skip()
+		{
+			while (cur == 0 && ++w < WORDS)
+				cur = e->word(w);
+			if (w > WORDS)
+				w = WORDS;
+		}
+	};
+
+	// Queries shared by all expression nodes
+	template<class E>
+	class Node
+	{
+	public:
+		inline int size() const
+		{
+			int res = 0;
+			for (int i = 0; i < 4 * E::LANES; ++i)
+				res += std::popcount(self().word(i));
+			return res;
+		}
+
+		inline bool empty() const
+		{
+			for (int i = 0; i < E::LANES; ++i)
+			{
+				__m256i x = self().lane(i);
+				if (!_mm256_testz_si256(x, x))
+					return false;
+			}
+			return true;
+		}
+
+		inline bool contains(int i) const { return (self().word(i >> 6) >> (i & 63)) & 1; }
+		inline int  count(int i) const { return contains(i); }
+
+		Iterator<E> begin() const { return Iterator<E>(&self(), 0); }
+		Iterator<E> end()   const { return Iterator<E>(&self(), 4 * E::LANES); }
+
+	private:
+		const E &self() const { return static_cast<const E&>(*this); }
+	};
+
+	template<class Op, class L, class R>
+	class Binary : public Node<Binary<Op, L, R>>
+	{
+	public:
+		static constexpr int LANES = std::remove_cvref_t<L>::LANES;
+
+		template<class A, class B>
+		Binary(A &&a, B &&b) : l(std::forward<A>(a)), r(std::forward<B>(b)) { }
+
+		inline __m256i lane(int i) const { return Op::lane(l.lane(i), r.lane(i)); }
+		inline uint64_t word(int i) const { return Op::word(l.word(i), r.word(i)); }
+
+	private:
+		L l;
+		R r;
+	};
+
+	template<class E>
+	class Not : public Node<Not<E>>
+	{
+	public:
+		static constexpr int LANES = std::remove_cvref_t<E>::LANES;
+
+		template<class A>
+		explicit Not(A &&a) : e(std::forward<A>(a)) { }
+
+		inline __m256i lane(int i) const { return _mm256_xor_si256(e.lane(i), _mm256_set1_epi64x(-1)); }
+		inline uint64_t word(int i) const { return ~e.word(i); }
+
+	private:
+		E e;
+	};
+
+	template<class Op, class L, class R>
+	inline auto make(L &&l, R &&r)
+	{
+		return Binary<Op, Held<L>, Held<R>>(std::forward<L>(l), std::forward<R>(r));
+	}
+}
+
+template<class L, class R> requires bitset_expr::Operand<std::remove_cvref_t<L>> && bitset_expr::Operand<std::remove_cvref_t<R>>
+inline auto operator&(L &&l, R &&r) { return bitset_expr::make<bitset_expr::And>(std::forward<L>(l), std::forward<R>(r)); }
+
+template<class L, class R> requires bitset_expr::Operand<std::remove_cvref_t<L>> && bitset_expr::Operand<std::remove_cvref_t<R>>
+inline auto operator|(L &&l, R &&r) { return bitset_expr::make<bitset_expr::Or>(std::forward<L>(l), std::forward<R>(r)); }
+
+template<class L, class R> requires bitset_expr::Operand<std::remove_cvref_t<L>> && bitset_expr::Operand<std::remove_cvref_t<R>>
+inline auto operator^(L &&l, R &&r) { return bitset_expr::make<bitset_expr::Xor>(std::forward<L>(l), std::forward<R>(r)); }
+
+template<class L, class R> requires bitset_expr::Operand<std::remove_cvref_t<L>> && bitset_expr::Operand<std::remove_cvref_t<R>>
+inline auto operator-(L &&l, R &&r) { return bitset_expr::make<bitset_expr::AndNot>(std::forward<L>(l), std::forward<R>(r)); }
+
+template<class E> requires bitset_expr::Operand<std::remove_cvref_t<E>>
+inline auto operator~(E &&e) { return bitset_expr::Not<bitset_expr::Held<E>>(std::forward<E>(e)); }
+
+// Subset test, in one pass and without materializing either side
+template<class L, class R> requires bitset_expr::Operand<L> && bitset_expr::Operand<R>
+inline bool operator<=(const L &l, const R &r)
+{
+	for (int i = 0; i < L::LANES; ++i)
+		if (!_mm256_testc_si256(r.lane(i), l.lane(i)))
+			return false;
+	return true;
+}
 
 template<int N>
 class LongBitset
@@ -50,83 +242,53 @@ public:
 		return res;
 	}
 
-	LongBitset& operator&=(const LongBitset &other)
-	{
-		__m256i *ld = (__m256i*)b;
-		__m256i const* rd = (__m256i const*) other.b;
-		for (int i = 0; i < N; ++i, ++ld, ++rd)
-		{
-			__m256i l = _mm256_lddqu_si256(ld);
-			__m256i r = _mm256_lddqu_si256(rd);
-			__m256i res = _mm256_and_si256(l, r);
-			_mm256_storeu_si256(ld, res);
-		}
-		return *this;
-	}
-	
-	LongBitset& operator|=(const LongBitset &other)
-	{
-		__m256i *ld = (__m256i*)b;
-		__m256i const* rd = (__m256i const*) other.b;
-		for (int i = 0; i < N; ++i, ++ld, ++rd)
-		{
-			__m256i l = _mm256_lddqu_si256(ld);
-			__m256i r = _mm256_lddqu_si256(rd);
-			__m256i res = _mm256_or_si256(l, r);
-			_mm256_storeu_si256(ld, res);
-		}
-		return *this;
-	}
-	
-	LongBitset& operator^=(const LongBitset &other)
+	// Evaluates an expression lane by lane straight into this bitset.
+	// Each lane of the result only depends on the same lane of the operands,
+	// so the expression may refer to this bitset itself.
+	template<class E> requires bitset_expr::Operand<E>
+	LongBitset(const E &e) { *this = e; }
+
+	template<class E> requires bitset_expr::Operand<E>
+	LongBitset &operator=(const E &e)
 	{
 		__m256i *ld = (__m256i*)b;
-		__m256i const* rd = (__m256i const*) other.b;
-		for (int i = 0; i < N; ++i, ++ld, ++rd)
-		{
-			__m256i l = _mm256_lddqu_si256(ld);
-			__m256i r = _mm256_lddqu_si256(rd);
-			__m256i res = _mm256_xor_si256(l, r);
-			_mm256_storeu_si256(ld, res);	
-		}
+		for (int i = 0; i < N; ++i, ++ld)
+			_mm256_store_si256(ld, e.lane(i));
 		return *this;
 	}
-	
-	LongBitset& operator-=(const LongBitset &other)
+
+	template<class E> requires bitset_expr::Operand<E>
+	LongBitset &operator&=(const E &e) { return *this = bitset_expr::Binary<bitset_expr::And, const LongBitset&, const E&>(*this, e); }
+	template<class E> requires bitset_expr::Operand<E>
+	LongBitset &operator|=(const E &e) { return *this = bitset_expr::Binary<bitset_expr::Or, const LongBitset&, const E&>(*this, e); }
+	template<class E> requires bitset_expr::Operand<E>
+	LongBitset &operator^=(const E &e) { return *this = bitset_expr::Binary<bitset_expr::Xor, const LongBitset&, const E&>(*this, e); }
+	template<class E> requires bitset_expr::Operand<E>
+	LongBitset &operator-=(const E &e) { return *this = bitset_expr::Binary<bitset_expr::AndNot, const LongBitset&, const E&>(*this, e); }
+
+	// Leaves of the expressions: 256-bit lanes and 64-bit words of the storage
+	static constexpr int LANES = N;
+	inline __m256i lane(int i) const { return _mm256_load_si256((__m256i const*)b + i); }
+	inline uint64_t word(int i) const { return b[i]; }
+
+	// Packs the bits at the positions set in `mask` into the lowest positions,
+	// keeping their order (a pext over the whole bitset).
+	LongBitset compress(const LongBitset &mask) const
 	{
-		__m256i *ld = (__m256i*)b;
-		__m256i const* rd = (__m256i const*) other.b;
-		for (int i = 0; i < N; ++i, ++ld, ++rd)
+		LongBitset res;
+		int pos = 0;
+		for (int i = 0; i < 4*N; ++i)
 		{
-			__m256i l = _mm256_lddqu_si256(ld);
-			__m256i r = _mm256_lddqu_si256(rd);
-			// For some reason, "andnot(x, y)" computes ~x & y
-			__m256i res = _mm256_andnot_si256(r, l);
-			_mm256_storeu_si256(ld, res);	
+			uint64_t x = pext(b[i], mask.b[i]);
+			int off = pos & LOW_MASK;
+			res.b[pos >> LOG_BITSIZE] |= x << off;
+			if (off != 0 && off + std::popcount(mask.b[i]) > BIT_SIZE)
+				res.b[(pos >> LOG_BITSIZE) + 1] |= x >> (BIT_SIZE - off);
+			pos += std::popcount(mask.b[i]);
 		}
-		return *this;
-	}
-
-	LongBitset operator&(const LongBitset &other) const { LongBitset res = *this; res &= other; return res; }
-	LongBitset operator|(const LongBitset &other) const { LongBitset res = *this; res |= other; return res; }
-	LongBitset operator^(const LongBitset &other) const { LongBitset res = *this; res ^= other; return res; }
-	LongBitset operator-(const LongBitset &other) const { LongBitset res = *this; res -= other; return res; }
-	
-	LongBitset operator~() const
-	{
-		LongBitset res = *this;
-		for (uint64_t &x: res.b)
-			x = ~x;
 		return res;
 	}
 
-	inline bool operator<=(const LongBitset &other) const
-	{
-		for (int i = 0; i < 4*N; ++i)
-			if ((b[i] & ~other.b[i]) != 0)
-				return false;
-		return true;
-	}
 
 	
 	struct Iterator 
@@ -154,7 +316,8 @@ public:
     Iterator begin(int from) const { return Iterator(*this, first_set(from)); }
     Iterator end()   const { return Iterator(*this, 4*N*BIT_SIZE); }
 private:
-	uint64_t b[4*N];
+	// Aligned, so that the SIMD operators can use aligned loads and stores
+	alignas(32) uint64_t b[4*N];
 
 
 	// Returns the index of the first bit set to 1,
@@ -183,6 +346,19 @@ private:
 
 		return std::countr_zero(x & ~mask);
 	}
+
+	static inline uint64_t pext(uint64_t x, uint64_t mask)
+	{
+#ifdef __BMI2__
+		return _pext_u64(x, mask);
+#else
+		uint64_t res = 0;
+		for (int i = 0; mask != 0; mask &= mask - 1, ++i)
+			if (x & mask & -mask)
+				res |= ONE << i;
+		return res;
+#endif
+	}
 };
 
 
@@ -8,6 +8,9 @@
 #include <chrono>
 
 #include "common.h"
+#include "context.h"
+#include "stats.h"
+#include "trace.h"
 
 template <class ItType, class RNG>
 int reservoir_sampling(ItType begin, ItType end, RNG &rng)
@@ -27,25 +30,19 @@ int reservoir_sampling(ItType begin, ItType end, RNG &rng)
 }
 
 /*
- * Property: for any subgraph H of G, tww(H) <= tww(G).
- * We use this as a lower bound: take a random subgraph of size k
- * and compute its twin-width.
+ * Grows a connected sample of (at most) k vertices from s.
+ * The next vertex is the one of highest priority among the neighbors of the sample,
+ * where the priority of u is bias(u) plus a uniform random number in [0, 1).
  */
-template <class T>
-int subgraph_lb(const T &g, int k, int prev_lb = 0)
+template <class T, class Bias>
+typename T::VxContainer grow_sample(const T &g, int s, int k, Bias &&bias, RNG &rng)
 {
-	static std::random_device rd;
-	static RNG rng(rd());
 	std::uniform_real_distribution unif(0.0, 1.0);
 
 	std::vector<bool> seen(g.n, false);
 	typename T::VxContainer h;
 	std::priority_queue<std::pair<float,int>> q;
-
-	// start with a random vertex
-	const auto &tmp = g.vertices();
-	int s = reservoir_sampling(tmp.begin(), tmp.end(), rng);
-	q.emplace(unif(rng), s);
+	q.emplace(bias(s) + unif(rng), s);
 
 	while ((int)h.size() < k && !q.empty())
 	{
@@ -56,22 +53,76 @@ int subgraph_lb(const T &g, int k, int prev_lb = 0)
 		seen[v] = true;
 
 		for (int u: g.neighbors(v))
-			q.emplace(unif(rng), u); // add u with random prioriy
+			q.emplace(bias(u) + unif(rng), u);
 		
 		for (int u: g.red_neighbors(v))
-			q.emplace(unif(rng), u); // add u with random prioriy
+			q.emplace(bias(u) + unif(rng), u);
 	}
 
+	return h;
+}
+
+/*
+ * Property: for any subgraph H of G, tww(H) <= tww(G).
+ * Returns the twin-width of the subgraph induced by h, or prev_lb
+ * if it is not larger than prev_lb.
+ * Results are cached by isomorphism class of H (see SubgraphCache).
+ */
+template <class T>
+int sample_lb(const T &g, const typename T::VxContainer &h, int prev_lb)
+{
+	STAT_INC(lb_samples);
+	STAT_ADD(lb_sample_vertices, h.size());
+	STAT_MAX(lb_max_sample, h.size());
+
 	// Solve on subgraph containing vertices of h
 	auto H = g.subgraph(h);
-	int min_score = INFTY;
-	MemType mem;
-	// Here we use the following trick: prev_lb can be seen as an lower bound for
-	// this graph: if we find a better smaller solution for H
-	// its optimal solution will not be a better lower bound.
-	auto &&[res, _] = mem_bab_aux_lb_init(H, prev_lb, min_score, mem);
-
-	return (res == INFTY) ? prev_lb : res;
+	auto &cache = SolverContext::current().lb_cache;
+	std::string key = cache.key(H);
+	if (int known; cache.lookup(key, prev_lb, known))
+	{
+		STAT_INC(lb_cache_hits);
+		return known;
+	}
+
+	// Only whether tww(H) > prev_lb matters: decide tww(H) <= prev_lb first,
+	// which prunes every branch as soon as its width exceeds prev_lb.
+	// When H beats the bound, the next values are decided in turn (usually, one is enough).
+	// The first merge of H gives a bound to start from, so that a small prev_lb
+	// (0 for the first samples) does not cost one BaB per value below it.
+	int res = std::max(prev_lb, greedy_lb(H));
+	for (;; ++res)
+	{
+		auto H2 = H;
+		if (bab_decide(H2, res))
+			break;
+	}
+	cache.store(std::move(key), prev_lb, res);
+
+	return res;
+}
+
+/*
+ * Take a random subgraph of size k, grown by random-priority BFS
+ * from a random vertex, and compute its twin-width.
+ */
+template <class T>
+int subgraph_lb(const T &g, int k, int prev_lb, RNG &rng)
+{
+	TraceSpan span("subgraph_lb", "k", k);
+
+	// start with a random vertex
+	const auto &tmp = g.vertices();
+	int s = reservoir_sampling(tmp.begin(), tmp.end(), rng);
+	auto h = grow_sample(g, s, k, [](int) { return 0.0f; }, rng);
+
+	return sample_lb(g, h, prev_lb);
+}
+
+template <class T>
+int subgraph_lb(const T &g, int k, int prev_lb = 0)
+{
+	return subgraph_lb(g, k, prev_lb, SolverContext::current().rng);
 }
 
 /*
@@ -80,6 +131,7 @@ int subgraph_lb(const T &g, int k, int prev_lb = 0)
 template <class T>
 int iter_subgraph_lb(const T &g, int k, int it)
 {
+	TraceSpan span("iter_subgraph_lb", "it", it);
 	int best = 0;
 	for (int i = 0; i < it; ++i)
 		best = std::max(best, subgraph_lb(g, k));
@@ -96,6 +148,7 @@ using namespace std::chrono;
 template <class T>
 int timed_iter_subgraph_lb(const T &g, int k, int sec_max)
 {
+	TraceSpan span("timed_iter_subgraph_lb", "sec_max", sec_max);
 	int best = 0;
 	auto start = high_resolution_clock::now();
 	while (duration_cast<seconds>(high_resolution_clock::now() - start).count() < sec_max)
@@ -108,11 +161,12 @@ int timed_iter_subgraph_lb(const T &g, int k, int sec_max)
 template <class T>
 int timed_iter_subgraph_lb_early_exit(const T &g, int best_score, int lb0, int k, int sec_max)
 {
+	TraceSpan span("timed_iter_subgraph_lb_early_exit", "sec_max", sec_max);
 	int best_lb = lb0;
 	auto start = high_resolution_clock::now();
 	while (duration_cast<seconds>(high_resolution_clock::now() - start).count() < sec_max)
 	{
-		best_lb = std::max(best_lb, subgraph_lb(g, k));
+		best_lb = subgraph_lb(g, k, best_lb);
 		if (best_lb >= best_score)
 			break;
 	}
@@ -127,6 +181,7 @@ int timed_iter_subgraph_lb_early_exit(const T &g, int best_score, int lb0, int k
 template <class T>
 int timed_growing_subgraph_lb(const T &g, int s0, int sec_max)
 {
+	TraceSpan span("timed_growing_subgraph_lb", "sec_max", sec_max);
 	int best = 0;
 	auto start = high_resolution_clock::now();
 	while (duration_cast<seconds>(high_resolution_clock::now() - start).count() < sec_max)
@@ -135,12 +190,12 @@ int timed_growing_subgraph_lb(const T &g, int s0, int sec_max)
 		if (lb <= best)
 		{
 			s0 += 1;
-			std::cerr << "New lb size: " << s0 << std::endl;
+			solver_log() << "New lb size: " << s0 << std::endl;
 		}
 		else
 		{
 			best = lb;
-			std::cerr << "New lb value: " << lb << std::endl;
+			solver_log() << "New lb value: " << lb << std::endl;
 		}
 
 		if (s0 >= g.actual_n())
@@ -150,20 +205,22 @@ int timed_growing_subgraph_lb(const T &g, int s0, int sec_max)
 }
 
 
+/*
+ * Any contraction sequence starts with a merge: the width is at least the smallest
+ * red degree that a merge creates (and at least the current width).
+ * O(n^2) merge costs: for graphs too large for that, see first_merge_lb.
+ */
 template<class T>
 int greedy_lb(const T &g)
 {
+	TraceSpan span("greedy_lb", "n", g.actual_n());
+	if (g.actual_n() <= 1)
+		return g.full_width();
 	int lb = INFTY;
 	for (int u: g.vertices())
 		for (int v: g.vertices())
-			if (u != v)
-			{
-				auto tmp = (g.neighbors(u) ^ g.neighbors(v));
-				tmp.erase(u);
-				tmp.erase(v);
-				if (tmp.size() < lb)
-					lb = tmp.size();
-			}
-
-	return lb;
-}
\ No newline at end of file
+			if (u < v)
+				lb = std::min(lb, (int)g.merge_cost(u, v).size());
+
+	return std::max(lb, g.full_width());
+}
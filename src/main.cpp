@@ -1,11 +1,11 @@
+#include <memory>
+
 #include "common.h"
-#include "long_bitset.hpp"
-#include "bgraph.h"
+#include "component_cache.h"
+#include "context.h"
 #include "graph.h"
-#include "bab.h"
-#include "upper_bound.h"
-#include "lower_bound.h"
-#include "large_graphs.h"
+#include "solver.h"
+#include "timing.h"
 
 using namespace std;
 
@@ -19,29 +19,49 @@ void print_sol(const contr_seq &sol)
 
 void solve_cin()
 {
-	auto g = Graph::from_cin();
-	g.kernelize_safe();
-    BitGraph::init(min(g.n, BitGraph::VxContainer::MAX_SIZE));
-
-	int max_cc_size = g.largest_cc_size();
+	Graph g = [] {
+		PhaseTimer t(Phase::Parse);
+		return Graph::from_cin();
+	}();
+	print_sol(solve(g));
+}
 
-	contr_seq sol;
-	if (max_cc_size > BitGraph::VxContainer::MAX_SIZE)
-	{
-		cerr << "Starting large graphs branch" << endl;
-		sol = solve_large(g);
-	}
-	else
+/*
+ * Usage: main [--config FILE] [--param name=value] ... [--cache FILE] < graph.gr
+ * The parameters of the config files and of --param apply after the installed profile
+ * (see ParamProfile), in the order given.
+ * --cache keeps the solved components in FILE (see ComponentCache), instead of $TINYWIDTH_CACHE.
+ */
+int main(int argc, char **argv)
+{
+	ParamProfile &prof = SolverContext::current().param_profile;
+	unique_ptr<ComponentCache> cache;
+	for (int i = 1; i < argc; ++i)
 	{
-		cerr << "Starting dense graphs branch" << endl;
-		sol = cc_bab_with_lb(g);
+		string arg = argv[i];
+		if (arg == "--cache" && i + 1 < argc)
+		{
+			cache = make_unique<ComponentCache>(argv[++i]);
+			SolverContext::current().component_cache = cache.get();
+		}
+		else if ((arg == "--config" || arg == "--param") && i + 1 < argc)
+		{
+			string val = argv[++i];
+			bool ok = (arg == "--config") ? prof.add_file(val) : prof.add_line(val);
+			if (!ok)
+			{
+				cerr << "Invalid " << arg << ": " << val << endl;
+				return 1;
+			}
+		}
+		else
+		{
+			cerr << "Unknown argument: " << arg << endl;
+			return 1;
+		}
 	}
-	print_sol(sol);
-}
 
-int main()
-{
 	solve_cin();
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,349 @@
+#include "modular.h"
+
+#include <algorithm>
+
+#include "trace.h"
+
+using namespace std;
+
+ModularDecomposition::ModularDecomposition(const Graph &g):
+	g(g), mark(g.n, 0), seen(g.n, 0), part(g.n), pos(g.n)
+{
+	TraceSpan span("modular_decomposition", "n", g.actual_n());
+	build();
+}
+
+Graph ModularDecomposition::leaf_graph(int leaf) const
+{
+	const auto &l = leaf_sets[leaf];
+	contr_seq edges;
+	for (int i = 0; i < (int)l.size(); ++i)
+		for (int w: g.neighbors(l[i]))
+		{
+			auto it = lower_bound(l.begin(), l.end(), w);
+			if (it != l.end() && *it == w && l[i] < w)
+				edges.emplace_back(i, it - l.begin());
+		}
+
+	return Graph::from_edges(l.size(), edges);
+}
+
+contr_seq ModularDecomposition::stitch(const vector<contr_seq> &leaf_sols) const
+{
+	contr_seq res;
+	if (nodes.empty())
+		return res;
+
+	// actual[r] is the vertex that currently stands for the nominal representative r
+	vector<int> actual(g.n);
+	for (int u = 0; u < g.n; ++u)
+		actual[u] = u;
+	vector<int> survivor(nodes.size());
+
+	// Post-order: the parts of a node are contracted first, then its quotient
+	vector<pair<int,int>> stack{{0, 0}};
+	while (!stack.empty())
+	{
+		auto [id, i] = stack.back();
+		const Node &node = nodes[id];
+		int k = node.children.size();
+		if (i < k)
+		{
+			++stack.back().second;
+			if (node.children[i] >= 0)
+				stack.emplace_back(node.children[i], 0);
+			continue;
+		}
+		if (i == k)
+		{
+			++stack.back().second;
+			for (int j = 0; j < k; ++j)
+				if (node.children[j] >= 0)
+					actual[node.reps[j]] = survivor[node.children[j]];
+			if (node.kind == Prime)
+			{
+				stack.emplace_back(node.quotient, 0);
+				continue;
+			}
+		}
+
+		switch (node.kind)
+		{
+		case Leaf:
+		{
+			const auto &l = leaf_sets[node.leaf];
+			const auto &sol = leaf_sols[node.leaf];
+			for (auto [u, v]: sol)
+				res.emplace_back(actual[l[u]], actual[l[v]]);
+			survivor[id] = sol.empty() ? actual[l[0]] : res.back().first;
+			break;
+		}
+		case Parallel:
+		case Series:
+			// The quotient is edgeless or complete: its vertices are twins
+			for (int j = 1; j < k; ++j)
+				res.emplace_back(actual[node.reps[0]], actual[node.reps[j]]);
+			survivor[id] = actual[node.reps[0]];
+			break;
+		case Prime:
+			survivor[id] = survivor[node.quotient];
+			break;
+		}
+		stack.pop_back();
+	}
+
+	return res;
+}
+
+/*************** Private Methods ***************/
+void ModularDecomposition::build()
+{
+	// Modules must be uniform for both colors: only black graphs are handled
+	for (int u: g.vertices())
+		if (g.red_deg(u) > 0)
+			return;
+	if (g.actual_n() < 2)
+		return;
+
+	vector<int> all(g.vertices().begin(), g.vertices().end());
+	sort(all.begin(), all.end());
+
+	vector<pair<int, vector<int>>> todo;
+	nodes.emplace_back();
+	todo.emplace_back(0, move(all));
+	while (!todo.empty())
+	{
+		auto [id, s] = move(todo.back());
+		todo.pop_back();
+
+		Node node;
+		node.kind = Parallel;
+		auto parts = components(s);
+		if (parts.size() == 1)
+		{
+			node.kind = Series;
+			parts = co_components(s);
+		}
+		if (parts.size() == 1)
+		{
+			// Try a second vertex, in case the first one is in a nontrivial module
+			node.kind = Prime;
+			auto singletons = [&] { return parts.size() == s.size(); };
+			parts = maximal_modules(s, s[0]);
+			if (singletons())
+				parts = maximal_modules(s, s[s.size() / 2]);
+			if (singletons())
+				node.kind = Leaf;
+		}
+
+		if (node.kind == Leaf)
+		{
+			node.leaf = leaf_sets.size();
+			leaf_sets.push_back(move(s));
+		}
+		else
+		{
+			for (auto &p: parts)
+			{
+				node.reps.push_back(p[0]);
+				if (p.size() == 1)
+					node.children.push_back(-1);
+				else
+				{
+					sort(p.begin(), p.end());
+					node.children.push_back(nodes.size());
+					nodes.emplace_back();
+					todo.emplace_back(nodes.size() - 1, move(p));
+				}
+			}
+			if (node.kind == Prime)
+			{
+				vector<int> q = node.reps;
+				sort(q.begin(), q.end());
+				node.quotient = nodes.size();
+				nodes.emplace_back();
+				todo.emplace_back(node.quotient, move(q));
+			}
+		}
+		nodes[id] = move(node);
+	}
+}
+
+vector<vector<int>> ModularDecomposition::components(const vector<int> &s)
+{
+	++stamp;
+	for (int u: s)
+	{
+		mark[u] = stamp;
+		part[u] = -1;
+	}
+
+	vector<vector<int>> res;
+	vector<int> q;
+	for (int u: s)
+	{
+		if (part[u] >= 0)
+			continue;
+		int c = res.size();
+		res.emplace_back();
+		part[u] = c;
+		q.push_back(u);
+		while (!q.empty())
+		{
+			int x = q.back(); q.pop_back();
+			res[c].push_back(x);
+			for (int w: g.neighbors(x))
+				if (mark[w] == stamp && part[w] < 0)
+				{
+					part[w] = c;
+					q.push_back(w);
+				}
+		}
+	}
+	return res;
+}
+
+// Components of the complement of G[s], in O(|s| + edges of G[s]):
+// when x is visited, the unvisited vertices are scanned once,
+// and those kept are neighbors of x.
+vector<vector<int>> ModularDecomposition::co_components(const vector<int> &s)
+{
+	vector<vector<int>> res;
+	vector<int> rest = s, keep, q;
+	while (!rest.empty())
+	{
+		res.emplace_back();
+		q.push_back(rest.back());
+		rest.pop_back();
+		while (!q.empty())
+		{
+			int x = q.back(); q.pop_back();
+			res.back().push_back(x);
+
+			++seen_stamp;
+			for (int w: g.neighbors(x))
+				seen[w] = seen_stamp;
+			keep.clear();
+			for (int y: rest)
+				(seen[y] == seen_stamp ? keep : q).push_back(y);
+			rest.swap(keep);
+		}
+	}
+	return res;
+}
+
+/*
+ * M(G[s], v): the maximal modules of G[s] not containing v, and {v}.
+ *
+ * Partition refinement from {N(v), {v}, non-neighbors of v}:
+ * a vertex y splits every part that does not contain it into its neighbors and the others.
+ * Every vertex splits once at the start. Then, each time a part is split into A and B,
+ * the vertices of the smaller side S need to split the other side again, and conversely:
+ *  - each y in S splits all parts (it is outside all the parts of the other side);
+ *  - the vertices of the other side adjacent to S are found by scanning the neighbors of S,
+ *    and each one splits the parts of S.
+ * Each vertex is on the smaller side O(log n) times, for O(m log^2 n) overall.
+ */
+vector<vector<int>> ModularDecomposition::maximal_modules(const vector<int> &s, int v)
+{
+	++stamp;
+	for (int u: s)
+		mark[u] = stamp;
+
+	vector<vector<int>> members(3);
+	vector<int> twin(3, -1);
+	const auto &nv = g.neighbors(v);
+	for (int u: s)
+	{
+		part[u] = (u == v) ? 2 : (nv.contains(u) ? 0 : 1);
+		pos[u] = members[part[u]].size();
+		members[part[u]].push_back(u);
+	}
+
+	vector<vector<int>> events;
+	vector<int> touched;
+	auto refine = [&](const vector<int> &t, int excluded) {
+		touched.clear();
+		for (int w: t)
+		{
+			int p = part[w];
+			if (p == excluded)
+				continue;
+			if (twin[p] < 0)
+			{
+				twin[p] = members.size();
+				members.emplace_back();
+				twin.push_back(-1);
+				touched.push_back(p);
+			}
+			int q = twin[p];
+			auto &mp = members[p];
+			int last = mp.back();
+			mp[pos[w]] = last;
+			pos[last] = pos[w];
+			mp.pop_back();
+			pos[w] = members[q].size();
+			members[q].push_back(w);
+			part[w] = q;
+		}
+
+		for (int p: touched)
+		{
+			int q = twin[p];
+			twin[p] = -1;
+			if (members[p].empty())
+			{
+				// Not a split: all of p moved
+				swap(members[p], members[q]);
+				for (int w: members[p])
+					part[w] = p;
+			}
+			else
+				events.push_back(members[p].size() < members[q].size() ? members[p] : members[q]);
+		}
+	};
+
+	vector<int> t;
+	auto pivot = [&](int y) {
+		t.clear();
+		for (int w: g.neighbors(y))
+			if (mark[w] == stamp)
+				t.push_back(w);
+		refine(t, part[y]);
+	};
+
+	for (int y: s)
+		pivot(y);
+
+	vector<pair<int,int>> adj;
+	for (size_t i = 0; i < events.size(); ++i)
+	{
+		vector<int> small = move(events[i]);
+		for (int y: small)
+			pivot(y);
+
+		++seen_stamp;
+		for (int x: small)
+			seen[x] = seen_stamp;
+		adj.clear();
+		for (int x: small)
+			for (int y: g.neighbors(x))
+				if (mark[y] == stamp && seen[y] != seen_stamp)
+					adj.emplace_back(y, x);
+		sort(adj.begin(), adj.end());
+		for (size_t j = 0; j < adj.size();)
+		{
+			int y = adj[j].first;
+			t.clear();
+			for (; j < adj.size() && adj[j].first == y; ++j)
+				t.push_back(adj[j].second);
+			refine(t, part[y]);
+		}
+	}
+
+	vector<vector<int>> res;
+	for (auto &m: members)
+		if (!m.empty())
+			res.push_back(move(m));
+	return res;
+}
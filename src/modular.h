@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+
+#include "common.h"
+#include "graph.h"
+
+/*
+ * Modular decomposition front end.
+ *
+ * If the vertices of G are partitioned into modules M1..Mk, G can be contracted
+ * by contracting each module into a single vertex, then contracting the quotient graph.
+ * Contractions inside a module only create red edges inside that module,
+ * so the width of the result is the maximum of the widths of the parts,
+ * which are all induced subgraphs of G: solving every part optimally is optimal for G.
+ *
+ * The decomposition is built top-down. A vertex set S is split:
+ *  - into its connected components (parallel node);
+ *  - otherwise into the components of its complement (series node);
+ *  - otherwise into M(G[S], v), the maximal modules of G[S] not containing some vertex v.
+ *    The quotient graph is then decomposed in turn.
+ * The quotients of parallel and series nodes have no red edge when contracted,
+ * and the sets that cannot be split (the prime nodes) are the leaves,
+ * solved independently by the dense or sparse engine.
+ *
+ * Only graphs without red edges can be decomposed (this is the case after kernelize_safe).
+ */
+class ModularDecomposition
+{
+public:
+	explicit ModularDecomposition(const Graph &g);
+
+	// True when the graph is a single prime node, i.e. nothing was gained.
+	inline bool trivial() const { return nodes.empty() || nodes[0].kind == Leaf; }
+
+	// Vertex sets to solve independently, sorted.
+	inline const std::vector<std::vector<int>> &leaves() const { return leaf_sets; }
+
+	// The subgraph induced by a leaf, where vertex i is leaves()[leaf][i].
+	Graph leaf_graph(int leaf) const;
+
+	// Builds a contraction sequence of g from the sequences of all the leaf graphs.
+	contr_seq stitch(const std::vector<contr_seq> &leaf_sols) const;
+
+private:
+	enum Kind {Leaf, Parallel, Series, Prime};
+
+	struct Node
+	{
+		Kind kind;
+		// One part per child: its nominal representative,
+		// and its node (-1 for single vertices)
+		std::vector<int> reps;
+		std::vector<int> children;
+		// Prime: node of the quotient graph, induced by reps
+		int quotient = -1;
+		// Leaf: index in leaf_sets
+		int leaf = -1;
+	};
+
+	const Graph &g;
+	std::vector<Node> nodes;
+	std::vector<std::vector<int>> leaf_sets;
+
+	// Scratch buffers, indexed by vertex.
+	// mark[u] == stamp for the vertices of the current set,
+	// seen[u] == seen_stamp for the vertices of the current subset.
+	std::vector<int> mark, seen, part, pos;
+	int stamp = 0, seen_stamp = 0;
+
+	void build();
+
+	std::vector<std::vector<int>> components(const std::vector<int> &s);
+	std::vector<std::vector<int>> co_components(const std::vector<int> &s);
+	std::vector<std::vector<int>> maximal_modules(const std::vector<int> &s, int v);
+};
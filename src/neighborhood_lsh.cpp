@@ -0,0 +1,166 @@
+#include "neighborhood_lsh.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace
+{
+	// splitmix64 finalizer
+	inline uint64_t mix(uint64_t x)
+	{
+		x += 0x9e3779b97f4a7c15ULL;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		return x ^ (x >> 31);
+	}
+}
+
+NeighborhoodLSH::NeighborhoodLSH(const Graph &g, RNG &rng, int bands, int rows):
+	bands(bands), rows(rows), seeds(bands * rows), mins((size_t)g.n * bands * rows),
+	keys((size_t)g.n * bands, NONE), pos((size_t)g.n * bands, -1), hash_u(bands * rows), hash_v(bands * rows)
+{
+	for (auto &s: seeds)
+		s = ((uint64_t)rng() << 32) | rng();
+
+	buckets.reserve(2 * g.actual_n() * bands);
+	for (int u: g.vertices())
+	{
+		rehash(g, u);
+		reindex(g, u);
+	}
+}
+
+void NeighborhoodLSH::merge(Graph &g, int u, int v, Si &&hint)
+{
+	int h = bands * rows;
+	bool adjacent = false;
+	changed.clear();
+	for (const Si *nbs: {&g.neighbors(v), &g.red_neighbors(v)})
+		for (int w: *nbs)
+		{
+			if (w == u)
+				adjacent = true;
+			else
+				changed.push_back(w);
+		}
+
+	g.merge(u, v, std::move(hint));
+	for (int b = 0; b < bands; ++b)
+		remove(v, b);
+
+	// N(u) becomes N(u) + N(v) - {u, v}: the minima of both hold, unless they were u or v
+	uint64_t *mu = &mins[(size_t)u * h], *mv = &mins[(size_t)v * h];
+	if (adjacent)
+		rehash(g, u);
+	else
+		for (int i = 0; i < h; ++i)
+			mu[i] = min(mu[i], mv[i]);
+	reindex(g, u);
+
+	// The former neighbors of v lose v, and have u (which they may already have had)
+	for (int i = 0; i < h; ++i)
+	{
+		hash_u[i] = hash(i, u);
+		hash_v[i] = hash(i, v);
+	}
+	for (int w: changed)
+	{
+		uint64_t *mw = &mins[(size_t)w * h];
+		bool lost = false;
+		for (int i = 0; i < h; ++i)
+			lost |= mw[i] == hash_v[i];
+		if (lost)
+			rehash(g, w);
+		else
+			for (int i = 0; i < h; ++i)
+				mw[i] = min(mw[i], hash_u[i]);
+		reindex(g, w);
+	}
+}
+
+int NeighborhoodLSH::candidate(int u, RNG &rng) const
+{
+	int first = rng() % bands;
+	for (int i = 0; i < bands; ++i)
+	{
+		int b = (first + i) % bands;
+		uint64_t k = keys[(size_t)u * bands + b];
+		if (k == NONE)
+			return -1;
+
+		const auto &bucket = buckets.at(k);
+		if (bucket.size() < 2)
+			continue;
+
+		// u is in the bucket: draw among the other vertices
+		int x = bucket[rng() % (bucket.size() - 1)];
+		return (x == u) ? bucket.back() : x;
+	}
+	return -1;
+}
+
+/*************** Private Methods ***************/
+inline uint64_t NeighborhoodLSH::hash(int i, int w) const
+{
+	return mix(seeds[i] ^ (uint64_t)w);
+}
+
+void NeighborhoodLSH::rehash(const Graph &g, int u)
+{
+	int h = bands * rows;
+	uint64_t *mu = &mins[(size_t)u * h];
+	fill(mu, mu + h, numeric_limits<uint64_t>::max());
+	for (const Si *nbs: {&g.neighbors(u), &g.red_neighbors(u)})
+		for (int w: *nbs)
+			for (int i = 0; i < h; ++i)
+				mu[i] = min(mu[i], hash(i, w));
+}
+
+void NeighborhoodLSH::reindex(const Graph &g, int u)
+{
+	// Isolated vertices are not indexed: any pair of them is free to merge anyway
+	bool isolated = g.total_deg(u) == 0;
+	const uint64_t *mu = &mins[(size_t)u * bands * rows];
+	for (int b = 0; b < bands; ++b)
+	{
+		uint64_t k = NONE;
+		if (!isolated)
+		{
+			k = mix(b);
+			for (int r = 0; r < rows; ++r)
+				k = mix(k ^ mu[b * rows + r]);
+			k |= 1; // never NONE
+		}
+
+		size_t i = (size_t)u * bands + b;
+		if (k == keys[i])
+			continue;
+		remove(u, b);
+		if (k != NONE)
+		{
+			auto &bucket = buckets[k];
+			keys[i] = k;
+			pos[i] = bucket.size();
+			bucket.push_back(u);
+		}
+	}
+}
+
+void NeighborhoodLSH::remove(int u, int b)
+{
+	size_t i = (size_t)u * bands + b;
+	if (keys[i] == NONE)
+		return;
+
+	auto it = buckets.find(keys[i]);
+	auto &bucket = it->second;
+	int last = bucket.back();
+	bucket[pos[i]] = last;
+	pos[(size_t)last * bands + b] = pos[i];
+	bucket.pop_back();
+	if (bucket.empty())
+		buckets.erase(it);
+	keys[i] = NONE;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "graph.h"
+#include "params.h"
+
+/*
+ * MinHash/LSH index over the neighborhoods (black and red) of a Graph.
+ *
+ * Each vertex gets `bands` keys, each one combining `rows` MinHash values of its neighborhood.
+ * Two vertices share the bucket of a band with probability J^rows,
+ * where J is the Jaccard similarity of their neighborhoods:
+ * vertices in the same bucket are likely to have a small symmetric difference,
+ * i.e. to be cheap to merge.
+ *
+ * Merging v into u only changes the neighborhoods of u and of the former neighbors of v,
+ * which lose v and gain u: their MinHash values are kept, and only recomputed from their
+ * neighborhood when v was one of the minima. Keys that do not change keep their buckets,
+ * and each vertex knows its position in its buckets, so that leaving one is O(1).
+ * The index can be copied, to restart from the same graph.
+ */
+class NeighborhoodLSH
+{
+public:
+	NeighborhoodLSH(const Graph &g, RNG &rng, int bands = DEFAULT_LSH_BANDS, int rows = DEFAULT_LSH_ROWS);
+
+	// Merges v into u in g (hint is g.merge_cost(u, v)), and updates the index.
+	void merge(Graph &g, int u, int v, Si &&hint);
+
+	// A random vertex sharing a bucket with u, or -1 if there is none.
+	int candidate(int u, RNG &rng) const;
+
+private:
+	int bands, rows;
+	std::vector<uint64_t> seeds;
+	// mins[u * bands * rows + i] is the MinHash value of the neighborhood of u for seeds[i]
+	std::vector<uint64_t> mins;
+	// keys[u * bands + b] is the key of u in band b (or NONE if u is not indexed),
+	// and pos[u * bands + b] the position of u in its bucket
+	std::vector<uint64_t> keys;
+	std::vector<int> pos;
+	// Buckets of all bands: the band is mixed into the key
+	std::unordered_map<uint64_t, std::vector<int>> buckets;
+	// Scratch buffers for merge
+	std::vector<int> changed;
+	std::vector<uint64_t> hash_u, hash_v;
+
+	static constexpr uint64_t NONE = 0;
+
+	uint64_t hash(int i, int w) const;
+	// Recomputes the MinHash values of u from its neighborhood
+	void rehash(const Graph &g, int u);
+	// Moves u to the buckets of its MinHash values (out of all of them if it is isolated)
+	void reindex(const Graph &g, int u);
+	void remove(int u, int b);
+};
@@ -0,0 +1,204 @@
+#include "params.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "bgraph.h"
+
+using namespace std;
+
+namespace
+{
+struct ParamInfo
+{
+	const char *name;
+	int SolverParams::*field;
+	int min, max;
+};
+
+constexpr int NO_MAX = numeric_limits<int>::max();
+
+// The heuristics need at least one run to return a sequence (close_merge_sparse is the only
+// upper bound of solve_large), and lb_k is the size of the sampled subgraphs,
+// which are BitGraphs: between 2 vertices and their maximum size.
+// The beam search keeps at least one state, and tries at least one contraction from each.
+constexpr ParamInfo PARAMS[] = {
+	{"tree", &SolverParams::tree, 1, NO_MAX},
+	{"outer", &SolverParams::outer, 1, NO_MAX},
+	{"inner", &SolverParams::inner, 1, NO_MAX},
+	{"outer_sp", &SolverParams::outer_sp, 1, NO_MAX},
+	{"inner_sp", &SolverParams::inner_sp, 1, NO_MAX},
+	{"lb_k", &SolverParams::lb_k, 2, BitGraph::VxContainer::MAX_SIZE},
+	{"lb_time_s", &SolverParams::lb_time_s, 0, NO_MAX},
+	{"beam_width", &SolverParams::beam_width, 1, BEAM_MAX_WIDTH},
+	{"beam_expand", &SolverParams::beam_expand, 1, BEAM_MAX_EXPAND},
+};
+
+const ParamInfo *find_param(const string &name)
+{
+	for (auto &p: PARAMS)
+		if (name == p.name)
+			return &p;
+	return nullptr;
+}
+
+// Parses all of s as a number
+template<class T>
+bool parse_number(const string &s, T &res)
+{
+	istringstream is(s);
+	return (is >> res) && is.eof();
+}
+}
+
+const vector<string> &SolverParams::names()
+{
+	static const vector<string> res = [] {
+		vector<string> v;
+		for (auto &p: PARAMS)
+			v.push_back(p.name);
+		return v;
+	}();
+	return res;
+}
+
+int *SolverParams::get(const string &name)
+{
+	const ParamInfo *p = find_param(name);
+	return p ? &(this->*(p->field)) : nullptr;
+}
+
+const int *SolverParams::get(const string &name) const
+{
+	return const_cast<SolverParams *>(this)->get(name);
+}
+
+bool SolverParams::set(const string &assignment)
+{
+	size_t eq = assignment.find('=');
+	if (eq == string::npos)
+		return false;
+	const ParamInfo *p = find_param(assignment.substr(0, eq));
+	int value;
+	if (!p || !parse_number(assignment.substr(eq + 1), value) || value < p->min || value > p->max)
+		return false;
+	this->*(p->field) = value;
+	return true;
+}
+
+string SolverParams::to_string() const
+{
+	string res;
+	for (auto &p: PARAMS)
+	{
+		if (!res.empty())
+			res += " ";
+		res += string(p.name) + "=" + std::to_string(this->*(p.field));
+	}
+	return res;
+}
+
+bool ParamProfile::Bucket::contains(int n, double deg) const
+{
+	return n >= min_n && (max_n < 0 || n < max_n)
+		&& deg >= min_deg && (max_deg < 0 || deg < max_deg);
+}
+
+bool ParamProfile::add_line(const string &line)
+{
+	istringstream is(line);
+	string tok;
+	Bucket b;
+	SolverParams check;
+	while (is >> tok)
+	{
+		if (tok[0] == '#')
+			break;
+		bool ok;
+		if (tok.starts_with("n>="))
+			ok = parse_number(tok.substr(3), b.min_n);
+		else if (tok.starts_with("n<"))
+			ok = parse_number(tok.substr(2), b.max_n);
+		else if (tok.starts_with("deg>="))
+			ok = parse_number(tok.substr(5), b.min_deg);
+		else if (tok.starts_with("deg<"))
+			ok = parse_number(tok.substr(4), b.max_deg);
+		else
+		{
+			ok = check.set(tok);
+			b.values.push_back(tok);
+		}
+		if (!ok)
+			return false;
+	}
+	if (!b.values.empty())
+		buckets.push_back(move(b));
+	return true;
+}
+
+bool ParamProfile::add_file(const string &path)
+{
+	ifstream ifs(path);
+	if (!ifs)
+	{
+		cerr << "Cannot read profile " << path << endl;
+		return false;
+	}
+	int lineno = 0;
+	for (string line; getline(ifs, line);)
+	{
+		++lineno;
+		if (!add_line(line))
+		{
+			cerr << path << ":" << lineno << ": invalid line: " << line << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+void ParamProfile::write(ostream &os) const
+{
+	for (auto &b: buckets)
+	{
+		if (b.min_n > 0)
+			os << "n>=" << b.min_n << " ";
+		if (b.max_n >= 0)
+			os << "n<" << b.max_n << " ";
+		if (b.min_deg > 0)
+			os << "deg>=" << b.min_deg << " ";
+		if (b.max_deg >= 0)
+			os << "deg<" << b.max_deg << " ";
+		for (size_t i = 0; i < b.values.size(); ++i)
+			os << (i > 0 ? " " : "") << b.values[i];
+		os << "\n";
+	}
+}
+
+SolverParams ParamProfile::select(int n, double deg) const
+{
+	SolverParams res;
+	for (auto &b: buckets)
+		if (b.contains(n, deg))
+			for (auto &v: b.values)
+				res.set(v);
+	return res;
+}
+
+const ParamProfile &ParamProfile::installed()
+{
+	static const ParamProfile res = [] {
+		ParamProfile p;
+		const char *path = getenv("TINYWIDTH_PROFILE");
+		if (path && !p.add_file(path))
+		{
+			cerr << "Profile " << path << " ignored: the default parameters apply" << endl;
+			p.buckets.clear();
+		}
+		return p;
+	}();
+	return res;
+}
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
 // Params
+// (the defaults of the ones that SolverParams can change at runtime)
 constexpr int LB_K = 25;
+// Maximum number of sampled subgraphs remembered by SubgraphCache
+constexpr int LB_CACHE_SIZE = 1 << 18;
 #ifdef OPTIL
 	#pragma message("Compiling OPTIL version")
 	constexpr int LB_TIME_S = 60;
@@ -15,3 +23,114 @@ constexpr int DEFAULT_INNER_SP = 50;
 constexpr int DEFAULT_TREE = 200;
 constexpr int DEFAULT_OUTER = 100;
 constexpr int DEFAULT_INNER = 200;
+
+// Rounds of color refinement for the keys of ComponentCache (large components rarely need more)
+constexpr int COMPONENT_CACHE_ROUNDS = 32;
+
+// Canonical orders (see refinement_order): leaves of the individualization-refinement search compared
+// at most, and largest trigraph searched (larger ones are only ordered by color refinement and index)
+constexpr int CANONICAL_MAX_LEAVES = 256;
+constexpr int CANONICAL_MAX_N = 256;
+
+// first_merge_lb: vertices of degree above max(FIRST_MERGE_HUB_DEG, sqrt(2m)) are not used as middles of 2-paths
+constexpr int FIRST_MERGE_HUB_DEG = 256;
+
+// apply_heur: number of slices of each randomized heuristic, and weight of the exploration term of UCB
+constexpr int HEUR_SLICES = 10;
+constexpr double HEUR_UCB_C = 0.5;
+
+// Beam search: number of partial trigraphs kept, and contractions tried from each (each state is a copy
+// of the trigraph, and each step scans all the pairs of each state), with their largest values,
+// and time budget (for the whole graph) as a fraction of the time of the lower bounds
+constexpr int DEFAULT_BEAM_WIDTH = 32;
+constexpr int DEFAULT_BEAM_EXPAND = 4;
+constexpr int BEAM_MAX_WIDTH = 1024;
+constexpr int BEAM_MAX_EXPAND = 64;
+constexpr double BEAM_TIME_FRACTION = 0.1;
+// Smaller graphs are searched by a single thread: a step takes less time than starting the workers
+constexpr int BEAM_PARALLEL_MIN_N = 48;
+
+// MinHash/LSH index of close_merge_sparse: number of bands, and of hashes per band
+constexpr int DEFAULT_LSH_BANDS = 8;
+constexpr int DEFAULT_LSH_ROWS = 2;
+
+// Local search on the heuristic solutions: time budget (for the whole graph),
+// as a fraction of the time of the lower bounds,
+// number of checkpoints of the trigraph along the sequence, annealing temperatures,
+// and size of the block moves
+constexpr double LS_TIME_FRACTION = 0.1;
+constexpr int LS_CHECKPOINTS = 16;
+constexpr double LS_T0 = 0.002;
+constexpr double LS_T1 = 0.00002;
+constexpr int LS_MAX_BLOCK = 4;
+constexpr int LS_MAX_SHIFT = 16;
+// Larger sparse graphs are not searched: each checkpoint is a full copy of the graph
+constexpr int LS_MAX_N_SPARSE = 20000;
+
+/*
+ * The parameters that can be changed at runtime, see ParamProfile.
+ * The solver reads them from the current SolverContext (see params() in context.h).
+ */
+struct SolverParams
+{
+	int tree = DEFAULT_TREE;
+	int outer = DEFAULT_OUTER;
+	int inner = DEFAULT_INNER;
+	int outer_sp = DEFAULT_OUTER_SP;
+	int inner_sp = DEFAULT_INNER_SP;
+	int lb_k = LB_K;
+	int lb_time_s = LB_TIME_S;
+	int beam_width = DEFAULT_BEAM_WIDTH;
+	int beam_expand = DEFAULT_BEAM_EXPAND;
+
+	inline double ls_time_s() const { return LS_TIME_FRACTION * lb_time_s; }
+	inline double beam_time_s() const { return BEAM_TIME_FRACTION * lb_time_s; }
+
+	// Names of the parameters, as used by set() and in the profiles
+	static const std::vector<std::string> &names();
+	// Pointer to the parameter `name`, or nullptr if there is none
+	int *get(const std::string &name);
+	const int *get(const std::string &name) const;
+	// Sets the parameter from "name=value": returns false if the assignment is invalid.
+	bool set(const std::string &assignment);
+	// All the parameters, as "name=value" separated by spaces
+	std::string to_string() const;
+};
+
+/*
+ * Parameters by buckets of graphs, read from a text file (or from the command line).
+ * Each line is a bucket:
+ *     [n>=A] [n<B] [deg>=C] [deg<D] name=value ...
+ * where n is the number of vertices and deg the average degree of the graph.
+ * The values of all the buckets whose bounds hold apply, in order:
+ * a line without bounds sets a parameter for all graphs, and is overridden by the lines after it.
+ * Empty lines and lines starting with '#' are ignored.
+ */
+class ParamProfile
+{
+public:
+	struct Bucket
+	{
+		int min_n = 0, max_n = -1;
+		double min_deg = 0, max_deg = -1;
+		std::vector<std::string> values;
+
+		bool contains(int n, double deg) const;
+	};
+
+	std::vector<Bucket> buckets;
+
+	// Parses a line of the profile (see above) and adds its bucket.
+	// Returns false (and adds nothing) if the line is invalid.
+	bool add_line(const std::string &line);
+	// Adds all the lines of the file: returns false if it cannot be read or a line is invalid.
+	bool add_file(const std::string &path);
+	void write(std::ostream &os) const;
+
+	// Parameters of a graph with n vertices and average degree deg
+	SolverParams select(int n, double deg) const;
+
+	// Profile loaded once from the file $TINYWIDTH_PROFILE, if it is set: each SolverContext starts with it.
+	// A profile that cannot be read, or has an invalid line, is reported and ignored.
+	static const ParamProfile &installed();
+};
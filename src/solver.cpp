@@ -0,0 +1,235 @@
+#include "solver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "bgraph.h"
+#include "bab.h"
+#include "canonical.h"
+#include "upper_bound.h"
+#include "lower_bound.h"
+#include "large_graphs.h"
+#include "modular.h"
+#include "timing.h"
+#include "stats.h"
+#include "trace.h"
+
+using namespace std;
+
+/*
+ * Solves g, sending each connected component to the dense or the large graphs branch,
+ * depending on its size. The components of the dense branch are solved first, all together,
+ * and the width they reach is the lower bound given to the large ones:
+ * those do not need to do better.
+ */
+static contr_seq solve_kernelized(const Graph &g, int lb0 = 0, int budget_n = 0)
+{
+	vector<int> small;
+	vector<vector<int>> large;
+	for (auto &c: g.connected_components())
+	{
+		if ((int)c.size() > BitGraph::VxContainer::MAX_SIZE)
+			large.push_back(move(c));
+		else
+			small.insert(small.end(), c.begin(), c.end());
+	}
+
+	if (large.empty())
+	{
+		solver_log() << "Starting dense graphs branch" << endl;
+		return cc_bab_with_lb(g, lb0, budget_n);
+	}
+
+	if (budget_n <= 0)
+		budget_n = g.actual_n();
+	contr_seq res = g.sol();
+	int lb = max(lb0, g.full_width());
+	int ub = 0;
+	// One vertex is left for each part, merged at the end
+	vector<int> repr;
+	auto append = [&](const vector<int> &vx, const contr_seq &sol) {
+		for (auto [u, v]: sol)
+			res.emplace_back(vx[u], vx[v]);
+		repr.push_back(sol.empty() ? vx[0] : vx[sol.back().first]);
+		lb = max(lb, profile().lb);
+		ub = max(ub, profile().ub);
+	};
+
+	if (!small.empty())
+	{
+		solver_log() << "Starting dense graphs branch on " << small.size() << " vertices" << endl;
+		sort(small.begin(), small.end());
+		append(small, cc_bab_with_lb(g.induced_subgraph(small), lb, budget_n));
+	}
+
+	sort(large.begin(), large.end(), [](const auto &a, const auto &b) { return a.size() < b.size(); });
+	for (const auto &c: large)
+	{
+		solver_log() << "Starting large graphs branch on " << c.size() << " vertices" << endl;
+		append(c, solve_large(g.induced_subgraph(c), lb, budget_n));
+		// The width reached here is reached by g anyway
+		lb = max(lb, profile().ub);
+	}
+
+	for (size_t i = 1; i < repr.size(); ++i)
+		res.emplace_back(repr[i], repr[i - 1]);
+
+	profile().lb = lb;
+	profile().ub = ub;
+	return res;
+}
+
+/*
+ * Solves the leaves of md in parallel, one SolverContext per thread.
+ * The widths found so far are shared: a leaf does not need to do better than the others.
+ * The leaves of the dense branch go first, largest first, and the large leaves
+ * only start once they are all solved, smallest first, with the width they reached.
+ * Dense leaves isomorphic to another one reuse its sequence.
+ */
+static vector<contr_seq> solve_leaves(const Graph &g, const ModularDecomposition &md)
+{
+	const auto &leaves = md.leaves();
+	vector<contr_seq> sols(leaves.size());
+	vector<int> dense, large;
+	for (int i = 0; i < (int)leaves.size(); ++i)
+		((int)leaves[i].size() > BitGraph::VxContainer::MAX_SIZE ? large : dense).push_back(i);
+	sort(dense.begin(), dense.end(), [&](int a, int b) { return leaves[a].size() > leaves[b].size(); });
+	sort(large.begin(), large.end(), [&](int a, int b) { return leaves[a].size() < leaves[b].size(); });
+
+	// Isomorphic dense leaves are solved once (see canonical.h):
+	// copies[i] are the leaves with the same key as leaf i, and orders[i] the order of its vertices
+	vector<vector<int>> orders(leaves.size()), copies(leaves.size());
+	{
+		unordered_map<string, int> first;
+		vector<int> color, kept;
+		vector<pair<vector<int>, int>> sig;
+		for (int i: dense)
+		{
+			Graph h = md.leaf_graph(i);
+			refinement_order(h, orders[i], color, sig, INFTY);
+			auto [it, inserted] = first.try_emplace(adjacency_key(h, orders[i]), i);
+			if (inserted)
+				kept.push_back(i);
+			else
+				copies[it->second].push_back(i);
+		}
+		dense = move(kept);
+	}
+
+	SolverContext &parent = SolverContext::current();
+	atomic<int> shared_lb = parent.profile.lb;
+	mutex parent_mutex;
+	// The bounds of g are the largest ones of its leaves
+	parent.profile.ub = g.full_width();
+
+	for (const vector<int> *order: {&dense, &large})
+	{
+		int threads = max(1, min(parent.threads, (int)order->size()));
+		atomic<size_t> next = 0;
+		auto worker = [&](uint64_t seed) {
+			// The threads left over are shared between the workers
+			SolverContext ctx = parent.worker(seed, max(1, parent.threads / threads));
+			SolverContext::Scope scope(ctx);
+			// ctx.profile only keeps the bounds of the last leaf
+			int lb = 0, ub = 0;
+			for (size_t i = next++; i < order->size(); i = next++)
+			{
+				int leaf = (*order)[i];
+				TraceSpan span("leaf", "n", leaves[leaf].size());
+				Graph h = md.leaf_graph(leaf);
+				sols[leaf] = solve_kernelized(h, shared_lb.load(), g.actual_n());
+				lb = max(lb, ctx.profile.lb);
+				ub = max(ub, ctx.profile.ub);
+
+				for (int cur = shared_lb.load(); cur < lb && !shared_lb.compare_exchange_weak(cur, lb);)
+					;
+			}
+
+			lock_guard lock(parent_mutex);
+			for (int p = 0; p < (int)Phase::Count; ++p)
+				parent.profile.seconds[p] += ctx.profile.seconds[p];
+			parent.profile.lb = max(parent.profile.lb, lb);
+			parent.profile.ub = max(parent.profile.ub, ub);
+			parent.join_worker(ctx);
+		};
+
+		vector<uint64_t> seeds(threads);
+		for (auto &s: seeds)
+			s = parent.rng();
+		if (order->empty())
+			continue;
+		if (threads == 1)
+			worker(seeds[0]);
+		else
+		{
+			vector<thread> pool;
+			for (int t = 0; t < threads; ++t)
+				pool.emplace_back(worker, seeds[t]);
+			for (auto &th: pool)
+				th.join();
+		}
+	}
+
+	for (int i = 0; i < (int)leaves.size(); ++i)
+	{
+		vector<int> pos(leaves[i].size());
+		for (int p = 0; p < (int)orders[i].size(); ++p)
+			pos[orders[i][p]] = p;
+		for (int c: copies[i])
+		{
+			STAT_INC(component_copies);
+			for (auto [u, v]: sols[i])
+				sols[c].emplace_back(orders[c][pos[u]], orders[c][pos[v]]);
+		}
+	}
+
+	return sols;
+}
+
+contr_seq solve(Graph &g)
+{
+	{
+		long long deg = 0;
+		for (int u: g.vertices())
+			deg += g.total_deg(u);
+		int n = g.actual_n();
+		SolverContext &ctx = SolverContext::current();
+		ctx.params = ctx.param_profile.select(n, n > 0 ? (double)deg / n : 0);
+		solver_log() << "Parameters: " << ctx.params.to_string() << endl;
+	}
+
+	{
+		PhaseTimer t(Phase::Kernel);
+		g.kernelize_safe();
+	}
+
+	ModularDecomposition md = [&] {
+		PhaseTimer t(Phase::Kernel);
+		return ModularDecomposition(g);
+	}();
+
+	contr_seq res;
+	if (md.trivial())
+		res = solve_kernelized(g);
+	else
+	{
+		solver_log() << "Modular decomposition: " << md.leaves().size() << " prime nodes" << endl;
+		auto sols = solve_leaves(g, md);
+		res = g.sol();
+		contr_seq sol = md.stitch(sols);
+		res.insert(res.end(), sol.begin(), sol.end());
+	}
+	stats_run(g.n);
+	return res;
+}
+
+contr_seq solve(SolverContext &ctx, int n, const contr_seq &edges)
+{
+	SolverContext::Scope scope(ctx);
+	ctx.profile.reset();
+	Graph g = Graph::from_edges(n, edges);
+	return solve(g);
+}
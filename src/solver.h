@@ -0,0 +1,16 @@
+#pragma once
+
+#include "common.h"
+#include "graph.h"
+#include "context.h"
+
+// Kernelizes g, then solves it with the dense or large graphs branch,
+// using the current SolverContext, with the parameters its profile gives to g.
+contr_seq solve(Graph &g);
+
+/*
+ * Library entry point: solves the graph with vertices 0..n-1 and the given edges
+ * in `ctx`, and returns a contraction sequence (with 0-indexed vertices).
+ * Reentrant: different threads may solve graphs concurrently with different contexts.
+ */
+contr_seq solve(SolverContext &ctx, int n, const contr_seq &edges);
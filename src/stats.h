@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+
+#include "timing.h"
+
+/*
+ * Counters on the hot paths of the solver.
+ * They are only collected when compiling with TINYWIDTH_STATS:
+ * otherwise, the stats_* functions do nothing, and the STAT_* macros only evaluate their arguments
+ * (for their side effects: the compiler drops the rest), so that both builds run the same code.
+ *
+ * A JSON record is written to stderr after each CC solved by cc_bab_with_lb
+ * (or after solve_large), and another one with the totals after each run.
+ */
+struct SolverStats
+{
+	long long bab_nodes = 0;
+	long long memo_hits = 0;
+	long long memo_inserts = 0;
+	long long prune_bound = 0; // branches cut because the width reached the best score
+	long long prune_lb = 0;    // branches cut because the best score reached the lower bound
+	long long kernel_moves = 0;
+	long long heur_restarts = 0;
+	long long heur_improvements = 0;
+	long long heur_aborts = 0; // restarts stopped because they reached the best width known
+	long long heur_slices = 0; // slices of randomized heuristics given out by apply_heur after the first round
+	long long lb_samples = 0;
+	long long lb_sample_vertices = 0;
+	long long lb_max_sample = 0;
+	long long lb_cache_hits = 0;
+	long long component_cache_hits = 0;
+	long long component_copies = 0; // components isomorphic to one solved before in the same graph
+	long long memo_bytes = 0;
+	long long peak_memo_bytes = 0;
+
+	void add(const SolverStats &o)
+	{
+		bab_nodes += o.bab_nodes;
+		memo_hits += o.memo_hits;
+		memo_inserts += o.memo_inserts;
+		prune_bound += o.prune_bound;
+		prune_lb += o.prune_lb;
+		kernel_moves += o.kernel_moves;
+		heur_restarts += o.heur_restarts;
+		heur_improvements += o.heur_improvements;
+		heur_aborts += o.heur_aborts;
+		heur_slices += o.heur_slices;
+		lb_samples += o.lb_samples;
+		lb_sample_vertices += o.lb_sample_vertices;
+		lb_max_sample = std::max(lb_max_sample, o.lb_max_sample);
+		lb_cache_hits += o.lb_cache_hits;
+		component_cache_hits += o.component_cache_hits;
+		component_copies += o.component_copies;
+		peak_memo_bytes = std::max(peak_memo_bytes, o.peak_memo_bytes);
+	}
+
+	void write_json_fields(std::ostream &os) const
+	{
+		os << "\"bab_nodes\": " << bab_nodes
+		   << ", \"memo_hits\": " << memo_hits
+		   << ", \"memo_inserts\": " << memo_inserts
+		   << ", \"prune_bound\": " << prune_bound
+		   << ", \"prune_lb\": " << prune_lb
+		   << ", \"kernel_moves\": " << kernel_moves
+		   << ", \"heur_restarts\": " << heur_restarts
+		   << ", \"heur_improvements\": " << heur_improvements
+		   << ", \"heur_aborts\": " << heur_aborts
+		   << ", \"heur_slices\": " << heur_slices
+		   << ", \"lb_samples\": " << lb_samples
+		   << ", \"lb_sample_vertices\": " << lb_sample_vertices
+		   << ", \"lb_max_sample\": " << lb_max_sample
+		   << ", \"lb_cache_hits\": " << lb_cache_hits
+		   << ", \"component_cache_hits\": " << component_cache_hits
+		   << ", \"component_copies\": " << component_copies
+		   << ", \"peak_memo_bytes\": " << peak_memo_bytes;
+	}
+};
+
+#ifdef TINYWIDTH_STATS
+
+// Stats of the CC being solved, and totals of the current run, in the current SolverContext.
+SolverStats &stats();
+SolverStats &run_stats();
+
+#define STAT_INC(field) (++stats().field)
+#define STAT_ADD(field, x) (stats().field += (x))
+#define STAT_MAX(field, x) (stats().field = std::max<long long>(stats().field, (x)))
+
+// Accounts for `bytes` more (or less) memory in the memo of the current BaB.
+#define STAT_MEMO_BYTES(bytes) (STAT_ADD(memo_bytes, bytes), STAT_MAX(peak_memo_bytes, stats().memo_bytes))
+// Accounts for the memo of the current BaB being freed.
+#define STAT_MEMO_CLEAR() STAT_MEMO_BYTES(-stats().memo_bytes)
+
+// Writes the record of the CC that was just solved, and adds it to the run totals.
+inline void stats_component(int index, int n, int ub, int lb, int score)
+{
+	auto &s = stats();
+	std::cerr << "{\"stats\": \"component\", \"index\": " << index
+			  << ", \"n\": " << n << ", \"ub\": " << ub
+			  << ", \"lb\": " << lb << ", \"score\": " << score << ", ";
+	s.write_json_fields(std::cerr);
+	std::cerr << "}" << std::endl;
+	run_stats().add(s);
+	s = SolverStats();
+}
+
+inline void stats_run(int n)
+{
+	auto &s = run_stats();
+	const auto &p = profile();
+	std::cerr << "{\"stats\": \"run\", \"n\": " << n << ", \"lb\": " << p.lb << ", \"ub\": " << p.ub << ", ";
+	s.write_json_fields(std::cerr);
+	for (int i = 0; i < (int)Phase::Count; ++i)
+		std::cerr << ", \"" << PHASE_NAMES[i] << "_s\": " << p.seconds[i];
+	std::cerr << "}" << std::endl;
+	s = SolverStats();
+}
+
+#else
+
+#define STAT_INC(field) ((void)0)
+#define STAT_ADD(field, x) ((void)(x))
+#define STAT_MAX(field, x) ((void)(x))
+#define STAT_MEMO_BYTES(bytes) ((void)(bytes))
+#define STAT_MEMO_CLEAR() ((void)0)
+
+inline void stats_component(int, int, int, int, int) { }
+inline void stats_run(int) { }
+
+#endif
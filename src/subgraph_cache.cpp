@@ -0,0 +1,44 @@
+#include "subgraph_cache.h"
+
+#include <algorithm>
+
+#include "canonical.h"
+#include "params.h"
+
+using namespace std;
+
+string SubgraphCache::key(const BitGraph &h)
+{
+	refinement_order(h, order, color, sig, INFTY);
+	return adjacency_key(h, order);
+}
+
+bool SubgraphCache::lookup(const string &key, int prev_lb, int &res) const
+{
+	auto it = entries.find(key);
+	if (it == entries.end())
+		return false;
+
+	const Entry &e = it->second;
+	if (e.exact)
+	{
+		res = max(e.value, prev_lb);
+		return true;
+	}
+	// Only an upper bound: useful if it is no better than the lower bound
+	if (e.value <= prev_lb)
+	{
+		res = prev_lb;
+		return true;
+	}
+	return false;
+}
+
+void SubgraphCache::store(string &&key, int prev_lb, int res)
+{
+	if (res == INFTY)
+		return;
+	if ((int)entries.size() >= LB_CACHE_SIZE)
+		entries.clear();
+	entries[move(key)] = Entry{res, res > prev_lb};
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "bgraph.h"
+
+/*
+ * Results of subgraph_lb, shared between samples that induce isomorphic trigraphs.
+ *
+ * The key of a trigraph lists its edges, in the order of the vertices given by refinement_order
+ * (see canonical.h): refinement separates all the vertices of most sampled subgraphs,
+ * so isomorphic samples mostly have equal keys.
+ * The key also contains the full width of the trigraph, which is inherited from the sampled graph.
+ *
+ * An entry is either the exact twin-width, or an upper bound found by a BaB that stopped
+ * as soon as it reached the previous lower bound.
+ */
+class SubgraphCache
+{
+public:
+	std::string key(const BitGraph &h);
+
+	// Result of sample_lb on a trigraph with this key, if known. Returns false otherwise.
+	bool lookup(const std::string &key, int prev_lb, int &res) const;
+	// Stores the result `res` of the BaB run with the lower bound prev_lb.
+	void store(std::string &&key, int prev_lb, int res);
+
+	inline void clear() { entries.clear(); }
+
+private:
+	struct Entry
+	{
+		int value;
+		bool exact;
+	};
+	std::unordered_map<std::string, Entry> entries;
+
+	// Scratch buffers of key
+	std::vector<int> color, order;
+	std::vector<std::pair<std::vector<int>, int>> sig;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+
+#include "common.h"
+
+/*
+ * Wall-clock time spent in each phase of the solver,
+ * along with the final bounds, for the last solved graph.
+ * Phases may be entered several times (e.g. once per CC):
+ * the times are accumulated.
+ */
+enum class Phase { Parse, Kernel, Upper, Lower, Bab, Count };
+
+constexpr std::array<const char *, (int)Phase::Count> PHASE_NAMES = {
+	"parse", "kernelize", "upper_bound", "lower_bound", "bab"
+};
+
+struct SolveProfile
+{
+	std::array<double, (int)Phase::Count> seconds{};
+	int lb = 0;
+	int ub = INFTY;
+
+	void reset() { *this = SolveProfile(); }
+};
+
+// Profile of the current SolverContext.
+SolveProfile &profile();
+
+// Adds the time elapsed between its construction and destruction to `phase`.
+class PhaseTimer
+{
+public:
+	explicit PhaseTimer(Phase phase): phase(phase), start(std::chrono::steady_clock::now()) { }
+	~PhaseTimer()
+	{
+		std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+		profile().seconds[(int)phase] += d.count();
+	}
+
+private:
+	Phase phase;
+	std::chrono::steady_clock::time_point start;
+};
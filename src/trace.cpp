@@ -0,0 +1,230 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace trace
+{
+	const char *const path = getenv("TINYWIDTH_TRACE");
+	const bool enabled = path != nullptr;
+
+	struct Event
+	{
+		const char *name;
+		const char *arg_name;
+		long long arg;
+		steady_clock::time_point start, end;
+	};
+
+	/*
+	 * Events of a single thread, only appended by that thread, in chunks that never move
+	 * (the first ones are small, as many threads only record a few events).
+	 * An event is published by incrementing the count of its chunk,
+	 * so that the signal handler can read the published events while the threads run.
+	 */
+	struct Chunk
+	{
+		static constexpr int MIN_SIZE = 64, MAX_SIZE = 4096;
+		int size;
+		Event *events;
+		atomic<int> count = 0;
+		atomic<Chunk *> next = nullptr;
+
+		explicit Chunk(int size): size(size), events(new Event[size]) { }
+		~Chunk() { delete[] events; }
+	};
+
+	struct Buffer
+	{
+		int tid;
+		Chunk *head, *tail;
+		// The buffers form a list, most recent thread first
+		Buffer *next;
+
+		void append(const Event &e)
+		{
+			int k = tail->count.load(memory_order_relaxed);
+			if (k == tail->size)
+			{
+				Chunk *c = new Chunk(min(2 * tail->size, Chunk::MAX_SIZE));
+				tail->next.store(c, memory_order_release);
+				tail = c;
+				k = 0;
+			}
+			tail->events[k] = e;
+			tail->count.store(k + 1, memory_order_release);
+		}
+	};
+
+	// Output through a fixed buffer and write(2) only, so that it can run in a signal handler
+	class Writer
+	{
+	public:
+		explicit Writer(int fd): fd(fd) { }
+		~Writer() { flush(); }
+
+		Writer &str(const char *s)
+		{
+			for (; *s; ++s)
+				put(*s);
+			return *this;
+		}
+
+		Writer &num(long long x)
+		{
+			char digits[24];
+			int k = 0;
+			unsigned long long y = x < 0 ? -(unsigned long long)x : x;
+			do
+				digits[k++] = '0' + y % 10;
+			while (y /= 10);
+			if (x < 0)
+				put('-');
+			while (k > 0)
+				put(digits[--k]);
+			return *this;
+		}
+
+		// Microseconds with 3 decimals
+		Writer &us(nanoseconds d)
+		{
+			long long ns = d.count();
+			num(ns / 1000);
+			put('.');
+			long long frac = (ns < 0 ? -ns : ns) % 1000;
+			put('0' + frac / 100);
+			put('0' + frac / 10 % 10);
+			put('0' + frac % 10);
+			return *this;
+		}
+
+	private:
+		int fd;
+		char buf[1 << 14];
+		size_t len = 0;
+
+		void put(char c)
+		{
+			if (len == sizeof(buf))
+				flush();
+			buf[len++] = c;
+		}
+
+		void flush()
+		{
+			for (size_t done = 0; done < len;)
+			{
+				ssize_t r = ::write(fd, buf + done, len - done);
+				if (r <= 0)
+					break;
+				done += r;
+			}
+			len = 0;
+		}
+	};
+
+	void on_signal(int sig);
+
+	class Tracer
+	{
+	public:
+		Tracer(): origin(steady_clock::now())
+		{
+			// A run stopped for exceeding its time budget still writes its trace
+			if (enabled)
+				for (int sig: {SIGTERM, SIGINT})
+				{
+					struct sigaction sa;
+					memset(&sa, 0, sizeof(sa));
+					sa.sa_handler = on_signal;
+					sigaction(sig, &sa, nullptr);
+				}
+		}
+
+		// The trace is written when the program exits, or on SIGTERM and SIGINT.
+		// The buffers are left to the end of the process: spans may still end after this.
+		~Tracer() { write(); }
+
+		Buffer &thread_buffer()
+		{
+			thread_local Buffer *buf = nullptr;
+			if (buf == nullptr)
+			{
+				Chunk *c = new Chunk(Chunk::MIN_SIZE);
+				buf = new Buffer{++n_buffers, c, c, buffers.load()};
+				while (!buffers.compare_exchange_weak(buf->next, buf, memory_order_release))
+					;
+			}
+			return *buf;
+		}
+
+		// Writes the events published so far. Only the first call writes.
+		void write()
+		{
+			if (!enabled || written.exchange(true))
+				return;
+			int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (fd < 0)
+				return;
+			{
+				Writer os(fd);
+				os.str("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+				bool first = true;
+				for (Buffer *buf = buffers.load(memory_order_acquire); buf != nullptr; buf = buf->next)
+				{
+					os.str(first ? "" : ",\n")
+						.str("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": ").num(buf->tid)
+						.str(", \"args\": {\"name\": \"thread ").num(buf->tid).str("\"}}");
+					first = false;
+					for (Chunk *c = buf->head; c != nullptr; c = c->next.load(memory_order_acquire))
+					{
+						int k = c->count.load(memory_order_acquire);
+						for (int i = 0; i < k; ++i)
+						{
+							const Event &e = c->events[i];
+							os.str(",\n{\"name\": \"").str(e.name)
+								.str("\", \"ph\": \"X\", \"pid\": 1, \"tid\": ").num(buf->tid)
+								.str(", \"ts\": ").us(e.start - origin)
+								.str(", \"dur\": ").us(e.end - e.start);
+							if (e.arg_name != nullptr)
+								os.str(", \"args\": {\"").str(e.arg_name).str("\": ").num(e.arg).str("}");
+							os.str("}");
+						}
+					}
+				}
+				os.str("\n]}\n");
+			}
+			close(fd);
+		}
+
+	private:
+		steady_clock::time_point origin;
+		atomic<Buffer *> buffers = nullptr;
+		atomic<int> n_buffers = 0;
+		atomic<bool> written = false;
+	};
+
+	static Tracer tracer;
+
+	// Writes the trace, then lets the signal stop the program as it would have
+	void on_signal(int sig)
+	{
+		tracer.write();
+		signal(sig, SIG_DFL);
+		raise(sig);
+	}
+
+	void record(const char *name, const char *arg_name, long long arg,
+			steady_clock::time_point start, steady_clock::time_point end)
+	{
+		tracer.thread_buffer().append({name, arg_name, arg, start, end});
+	}
+}
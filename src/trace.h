@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+
+/*
+ * Timeline of the solver phases, in the Chrome trace-event format
+ * (can be opened in chrome://tracing or https://ui.perfetto.dev).
+ *
+ * Tracing is enabled by setting the TINYWIDTH_TRACE environment variable
+ * to the path of the output file, which is written when the program exits,
+ * or when it is stopped by SIGTERM or SIGINT (e.g. at the end of its time budget).
+ * When it is not set, a span only costs a branch.
+ */
+namespace trace
+{
+	extern const bool enabled;
+
+	// Records a complete event; `arg_name` may be null.
+	void record(const char *name, const char *arg_name, long long arg,
+			std::chrono::steady_clock::time_point start,
+			std::chrono::steady_clock::time_point end);
+}
+
+// Records the time between its construction and destruction as an event.
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char *name, const char *arg_name = nullptr, long long arg = 0):
+		name(name), arg_name(arg_name), arg(arg)
+	{
+		if (trace::enabled)
+			start = std::chrono::steady_clock::now();
+	}
+
+	~TraceSpan()
+	{
+		if (trace::enabled)
+			trace::record(name, arg_name, arg, start, std::chrono::steady_clock::now());
+	}
+
+	TraceSpan(const TraceSpan &) = delete;
+	TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+	const char *name;
+	const char *arg_name;
+	long long arg;
+	std::chrono::steady_clock::time_point start;
+};
@@ -1,12 +1,30 @@
 #pragma once
 
 #include "common.h"
-
+#include "context.h"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cmath>
+#include <functional>
 #include <queue>
+#include <thread>
+#include <unordered_set>
 
 #include "params.h"
+#include "stats.h"
+#include "trace.h"
 
 using std::vector;
+
+/*
+ * All the heuristics take a cutoff: the best width known elsewhere (or INFTY).
+ * A restart stops as soon as its width reaches the cutoff, or the best width of its own
+ * previous restarts, and a heuristic that did not beat the cutoff returns (INFTY, {}).
+ */
+
 // Tree heuristic: process the graph as if it were a tree.
 // Works well for sparse, tree-like graphs
 template <class G>
@@ -52,7 +70,7 @@ int tree_merge_aux(int u, vector<bool> &seen, G &g, contr_seq &sol)
 }
 
 template <class G>
-std::pair<int, contr_seq> tree_merge_no_copy(G &g, RNG &rng)
+std::pair<int, contr_seq> tree_merge_no_copy(G &g, RNG &rng, int cutoff = INFTY)
 {
 	vector<bool> seen(g.n, false);
 	contr_seq sol;
@@ -63,7 +81,14 @@ std::pair<int, contr_seq> tree_merge_no_copy(G &g, RNG &rng)
 	std::shuffle(order.begin(), order.end(), rng);
 
 	for (int u: order)
+	{
 		tree_merge_aux(u, seen, g, sol);
+		if (g.full_width() >= cutoff)
+		{
+			STAT_INC(heur_aborts);
+			return make_pair(INFTY, contr_seq());
+		}
+	}
 
 
 	// Merge the remaining isolated vertices
@@ -77,22 +102,31 @@ std::pair<int, contr_seq> tree_merge_no_copy(G &g, RNG &rng)
 		sol.emplace_back(order[0], order[i]);
 	}
 
+	if (g.full_width() >= cutoff)
+	{
+		STAT_INC(heur_aborts);
+		return make_pair(INFTY, contr_seq());
+	}
 	return make_pair(g.full_width(), sol);
 }
 
 // TODO: add iterations
 template <class G>
-std::pair<int, contr_seq> tree_merge(const G &g_init, RNG &rng, int it)
+std::pair<int, contr_seq> tree_merge(const G &g_init, RNG &rng, int it, int cutoff = INFTY)
 {
+	TraceSpan span("tree_merge", "it", it);
 	auto g = g_init;
-	auto &&[score, sol] = tree_merge_no_copy(g, rng);
+	auto &&[score, sol] = tree_merge_no_copy(g, rng, cutoff);
+	STAT_INC(heur_restarts);
 
 	for (int i = 1; i < it; ++i)
 	{
 		g = g_init;
-		auto &&[score2, sol2] = tree_merge_no_copy(g, rng);
+		auto &&[score2, sol2] = tree_merge_no_copy(g, rng, std::min(score, cutoff));
+		STAT_INC(heur_restarts);
 		if (score2 < score)
 		{
+			STAT_INC(heur_improvements);
 			score = score2;
 			sol = sol2;
 		}
@@ -131,18 +165,21 @@ std::pair<int, int> random_neighbors(int x, const G &g, RNG &rng)
 }
 
 template <class G>
-std::pair<int, contr_seq> close_merge(const G &g_init, RNG &rng, int outer_it, int inner_it)
+std::pair<int, contr_seq> close_merge(const G &g_init, RNG &rng, int outer_it, int inner_it, int cutoff = INFTY)
 {	
+	TraceSpan span("close_merge", "outer_it", outer_it);
 	contr_seq best_sol;
 	int best_cost = INFTY;
 
 	for (int oit = 0; oit < outer_it; ++oit)
 	{
+		STAT_INC(heur_restarts);
 		auto g = g_init;
 		contr_seq cur_sol = g.kernelize();
+		int bound = std::min(best_cost, cutoff);
 
 		vector<int> deg_gt_2;
-		while (g.actual_n() > 1)
+		while (g.actual_n() > 1 && g.full_width() < bound)
 		{
 			deg_gt_2.clear();
 			for (int u: g.vertices())
@@ -152,7 +189,7 @@ std::pair<int, contr_seq> close_merge(const G &g_init, RNG &rng, int outer_it, i
 			if (deg_gt_2.empty())
 			{
 				// Degree max is 2, use tree method
-				auto &&[score_tree, sol_tree] = tree_merge_no_copy(g, rng);
+				auto &&[score_tree, sol_tree] = tree_merge_no_copy(g, rng, bound);
 				cur_sol.insert(cur_sol.end(), sol_tree.begin(), sol_tree.end());
 				break;
 			}
@@ -178,9 +215,12 @@ std::pair<int, contr_seq> close_merge(const G &g_init, RNG &rng, int outer_it, i
 			auto tmp = g.kernelize();
 			cur_sol.insert(cur_sol.end(), tmp.begin(), tmp.end());
 		}
-	
-		if (g.full_width() < best_cost)
+
+		if (g.full_width() >= bound || g.actual_n() > 1)
+			STAT_INC(heur_aborts);
+		else
 		{
+			STAT_INC(heur_improvements);
 			best_cost = g.full_width();
 			best_sol = std::move(cur_sol);
 		}
@@ -191,13 +231,17 @@ std::pair<int, contr_seq> close_merge(const G &g_init, RNG &rng, int outer_it, i
 
 /***** Greedy mincost : merge the pair of vertices with smallest approximate fusion cost ****/
 template <class G>
-std::pair<int, contr_seq> greedy_mincost(const G &g_init)
+std::pair<int, contr_seq> greedy_mincost(const G &g_init, int cutoff = INFTY)
 {	
+	TraceSpan span("greedy_mincost", "n", g_init.actual_n());
+	STAT_INC(heur_restarts);
 	auto g = g_init;
 	contr_seq cur_sol = g.kernelize();
 
 	while (g.actual_n() > 1)
 	{
+		if (g.full_width() >= cutoff)
+			break;
 		std::pair<int,int> best_uv(-1, -1);
 		typename G::VxContainer best_hint;
 		for (int u: g.vertices())
@@ -222,6 +266,11 @@ std::pair<int, contr_seq> greedy_mincost(const G &g_init)
 		cur_sol.insert(cur_sol.end(), tmp.begin(), tmp.end());
 	}
 
+	if (g.full_width() >= cutoff)
+	{
+		STAT_INC(heur_aborts);
+		return make_pair(INFTY, contr_seq());
+	}
 	return make_pair(g.full_width(), std::move(cur_sol));
 }
 
@@ -259,8 +308,10 @@ void update_floyd_warshall(vector<vector<int>> &res, int u, int v, const G &g)
 }
 
 template <class G>
-std::pair<int, contr_seq> greedy_mincost_local(const G &g_init)
+std::pair<int, contr_seq> greedy_mincost_local(const G &g_init, int cutoff = INFTY)
 {
+	TraceSpan span("greedy_mincost_local", "n", g_init.actual_n());
+	STAT_INC(heur_restarts);
 	auto g = g_init;
 	contr_seq cur_sol;
 
@@ -282,6 +333,8 @@ std::pair<int, contr_seq> greedy_mincost_local(const G &g_init)
 	int prev = -1;
 	while (g.actual_n() > 1)
 	{
+		if (g.full_width() >= cutoff)
+			break;
 		std::pair<int, int> best_uv(-1, -1);
 		std::pair<int, int> best_cost;
 		if (prev < 0)
@@ -331,46 +384,277 @@ std::pair<int, contr_seq> greedy_mincost_local(const G &g_init)
 
 	}
 
+	if (g.full_width() >= cutoff)
+	{
+		STAT_INC(heur_aborts);
+		return make_pair(INFTY, contr_seq());
+	}
 	return make_pair(g.full_width(), std::move(cur_sol));
 }
 
 
-// Aggregate heuristics
+/***** Beam search: keep the best partial trigraphs at each depth ****/
+template <class G>
+struct BeamState
+{
+	G g;
+	contr_seq sol;
+	// (full width, sum of the red degrees)
+	std::pair<int, int> score;
+};
+
+template <class G>
+std::pair<int, int> beam_score(const G &g)
+{
+	int red = 0;
+	for (int u: g.vertices())
+		red += g.red_deg(u);
+	return std::make_pair(g.full_width(), red);
+}
+
+// The `expand` contractions of g with the smallest merge cost,
+// each followed by kernelization.
+template <class G>
+vector<BeamState<G>> beam_children(const BeamState<G> &s, int expand)
+{
+	const G &g = s.g;
+	vector<std::pair<int, std::pair<int,int>>> best;
+	for (int u: g.vertices())
+		for (int v: g.vertices())
+		{
+			if (u >= v)
+				continue;
+			int cost = g.merge_cost(u, v).size();
+			if ((int)best.size() == expand && cost >= best.back().first)
+				continue;
+			if ((int)best.size() == expand)
+				best.pop_back();
+			auto it = std::upper_bound(best.begin(), best.end(), cost,
+				[](int c, const auto &b) { return c < b.first; });
+			best.emplace(it, cost, std::make_pair(u, v));
+		}
+
+	vector<BeamState<G>> res;
+	for (auto &[cost, uv]: best)
+	{
+		BeamState<G> c{g, s.sol, {}};
+		c.g.merge_nohint(uv.first, uv.second);
+		c.sol.push_back(uv);
+		auto tmp = c.g.kernelize();
+		c.sol.insert(c.sol.end(), tmp.begin(), tmp.end());
+		c.score = beam_score(c.g);
+		res.push_back(std::move(c));
+	}
+	return res;
+}
+
+/*
+ * Keeps the `width` best partial trigraphs, scored by width then sum of red degrees.
+ * Each step expands every state with its `expand` cheapest contractions,
+ * and the children with the same partition (get_key) are kept once.
+ * The states of a step are expanded in parallel, by a pool of workers started once for the whole search
+ * (with worker contexts of the current one), unless g_init is smaller than BEAM_PARALLEL_MIN_N.
+ * After `seconds`, only the best state is kept, so that the search still ends with a sequence.
+ */
+template <class G>
+std::pair<int, contr_seq> beam_search(const G &g_init, int width = params().beam_width, int expand = params().beam_expand,
+									  int cutoff = INFTY, double seconds = INFINITY)
+{
+	TraceSpan span("beam_search", "width", width);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(std::min(seconds, 1e9));
+	STAT_INC(heur_restarts);
+	vector<BeamState<G>> beam;
+	{
+		BeamState<G> s{g_init, {}, {}};
+		s.sol = s.g.kernelize();
+		s.score = beam_score(s.g);
+		beam.push_back(std::move(s));
+	}
+
+	std::pair<int, contr_seq> best(INFTY, contr_seq());
+	vector<vector<BeamState<G>>> children;
+	std::atomic<size_t> next = 0;
+	auto expand_all = [&] {
+		for (size_t i = next++; i < beam.size(); i = next++)
+			children[i] = beam_children(beam[i], expand);
+	};
+
+	// The pool waits at `start` for the next step (or the end of the search), and at `done` after each step
+	SolverContext &parent = SolverContext::current();
+	int threads = (g_init.actual_n() < BEAM_PARALLEL_MIN_N) ? 1 : std::min(parent.threads, width);
+	std::barrier start(threads), done(threads);
+	bool stop = false;
+	vector<SolverContext> contexts;
+	for (int j = 1; j < threads; ++j)
+		contexts.push_back(parent.worker(parent.rng(), 1));
+	vector<std::thread> pool;
+	for (int j = 1; j < threads; ++j)
+		pool.emplace_back([&, j] {
+			SolverContext::Scope scope(contexts[j - 1]);
+			while (true)
+			{
+				start.arrive_and_wait();
+				if (stop)
+					break;
+				expand_all();
+				done.arrive_and_wait();
+			}
+		});
+
+	while (!beam.empty())
+	{
+		children.assign(beam.size(), {});
+		next = 0;
+		start.arrive_and_wait();
+		expand_all();
+		done.arrive_and_wait();
+
+		vector<BeamState<G>> all;
+		for (auto &cs: children)
+			for (auto &c: cs)
+			{
+				if (c.score.first >= std::min(best.first, cutoff))
+				{
+					STAT_INC(heur_aborts);
+					continue;
+				}
+				if (c.g.actual_n() == 1)
+					best = std::make_pair(c.score.first, std::move(c.sol));
+				else
+					all.push_back(std::move(c));
+			}
+		std::sort(all.begin(), all.end(), [](const auto &a, const auto &b) { return a.score < b.score; });
+
+		if (width > 1 && std::chrono::steady_clock::now() > deadline)
+			width = 1;
+		beam.clear();
+		std::unordered_set<std::string> keys;
+		for (auto &c: all)
+		{
+			if ((int)beam.size() == width)
+				break;
+			if (keys.insert(c.g.get_key()).second)
+				beam.push_back(std::move(c));
+		}
+	}
+
+	stop = true;
+	start.arrive_and_wait();
+	for (auto &th: pool)
+		th.join();
+	for (auto &ctx: contexts)
+		parent.join_worker(ctx);
+	return best;
+}
+
+
+/*
+ * Aggregate heuristics, as a bandit over the heuristics of the component.
+ * The deterministic ones (greedy_mincost, greedy_mincost_local) are run once: greedy_mincost first,
+ * and greedy_mincost_local, the slowest, last, so that it is cut off by the best width found.
+ * The randomized ones (tree_merge, close_merge) run in slices of 1 / HEUR_SLICES of their
+ * iterations. After a first slice of each, the number of slices they would run in total
+ * is given out one slice at a time by UCB:
+ * the reward of a heuristic is the width it gained over the best solution so far,
+ * per slice, normalized by the best rate.
+ * A heuristic that never gains keeps a share of the slices through the exploration term.
+ * The clock is not used, so that runs with the same seed take the same choices.
+ */
 template <class G>
 std::pair<int, contr_seq> apply_heur(const G &g,
-									int tree_it = DEFAULT_TREE, 
-									int outer_it = DEFAULT_OUTER,
-									int inner_it = DEFAULT_INNER)
+									int tree_it = params().tree,
+									int outer_it = params().outer,
+									int inner_it = params().inner,
+									int cutoff = INFTY)
 {
-	static std::random_device rd;
-	static RNG rng(rd());
-	auto &&res = greedy_mincost(g);
-	auto &&p1 = tree_merge(g, rng, tree_it);
-	if (p1.first < res.first)
-		res = p1;
-
-	auto &&p2 = close_merge(g, rng, outer_it, inner_it);
-	if (p2.first < res.first)
-		res = p2;
-
-	auto &&p3 = greedy_mincost_local(g);
-	if (p3.first < res.first)
-		res = p3;
-
-	return std::move(res);
+	TraceSpan span("apply_heur", "n", g.actual_n());
+	RNG &rng = SolverContext::current().rng;
+
+	struct Arm
+	{
+		std::function<std::pair<int, contr_seq>(int)> run;
+		bool repeat;
+		int pulls = 0;
+		double gain = 0;
+	};
+	int tree_slice = std::max(1, tree_it / HEUR_SLICES);
+	int outer_slice = std::max(1, outer_it / HEUR_SLICES);
+	vector<Arm> arms;
+	arms.push_back({[&](int c) { return greedy_mincost(g, c); }, false});
+	if (tree_it > 0)
+		arms.push_back({[&](int c) { return tree_merge(g, rng, tree_slice, c); }, true});
+	if (outer_it > 0)
+		arms.push_back({[&](int c) { return close_merge(g, rng, outer_slice, inner_it, c); }, true});
+
+	// Each heuristic only has to beat the best width found so far
+	std::pair<int, contr_seq> res(INFTY, contr_seq());
+	// Any sequence has width less than n: the gain of the first solution is counted from there
+	int reference = std::max(g.actual_n(), g.full_width() + 1);
+	int total_pulls = 0;
+	auto pull = [&](Arm &a) {
+		auto x = a.run(std::min(res.first, cutoff));
+		++a.pulls;
+		++total_pulls;
+		int before = std::min(res.first, reference);
+		if (x.first < before)
+			a.gain += before - x.first;
+		if (x.first < res.first)
+			res = std::move(x);
+	};
+
+	for (auto &a: arms)
+		pull(a);
+
+	// The slices left if they were split evenly
+	int budget = 0;
+	for (auto &a: arms)
+		budget += a.repeat ? HEUR_SLICES - 1 : 0;
+	for (int slice = 0; slice < budget; ++slice)
+	{
+		double best_rate = 0;
+		for (auto &a: arms)
+			if (a.repeat)
+				best_rate = std::max(best_rate, a.gain / a.pulls);
+
+		Arm *next = nullptr;
+		double next_score = -1;
+		for (auto &a: arms)
+		{
+			if (!a.repeat)
+				continue;
+			double rate = a.gain / a.pulls;
+			double score = (best_rate > 0 ? rate / best_rate : 0)
+				+ HEUR_UCB_C * std::sqrt(std::log(total_pulls) / a.pulls);
+			if (score > next_score)
+			{
+				next = &a;
+				next_score = score;
+			}
+		}
+		STAT_INC(heur_slices);
+		pull(*next);
+	}
+
+	auto x = greedy_mincost_local(g, std::min(res.first, cutoff));
+	if (x.first < res.first)
+		res = std::move(x);
+	return res;
 }
 
 
 template <class G>
-std::pair<int, contr_seq> best_heur(const G &g)
+std::pair<int, contr_seq> best_heur(const G &g, int cutoff = INFTY)
 {
-	auto x1 = apply_heur(g);
+	TraceSpan span("best_heur", "n", g.actual_n());
+	auto x1 = apply_heur(g, params().tree, params().outer, params().inner, cutoff);
 
 	auto g2 = g;
 	auto kernel_op = g2.kernelize_heur();
-	auto x2 = apply_heur(g2);
-	kernel_op.insert(kernel_op.end(), x2.second.begin(), x2.second.end());
-	std::swap(kernel_op, x2.second);
-	
-	return std::min(x1, x2);
+	auto x2 = apply_heur(g2, params().tree, params().outer, params().inner, std::min(x1.first, cutoff));
+	if (x2.first < x1.first)
+	{
+		kernel_op.insert(kernel_op.end(), x2.second.begin(), x2.second.end());
+		return std::make_pair(x2.first, std::move(kernel_op));
+	}
+	return x1;
 }
\ No newline at end of file
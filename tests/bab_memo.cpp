@@ -0,0 +1,102 @@
+/*
+ * Checks that the BaB memos are keyed by kernelized trigraphs, as their readers expect:
+ * mem_bab_replay follows the memo of mem_bab_aux_lb_init from each kernelized trigraph,
+ * and the decision BaB of sample_lb kernelizes each trigraph before it looks up its `failed` key.
+ * Kernelization must not depend on TINYWIDTH_STATS: this runs in the default build, without stats.
+ *
+ * The graphs are random, with planted twins so that kernelization always has work to do.
+ * Returns 1 (and tells which graph) if a key is missing.
+ */
+#include <iostream>
+
+#include "common.h"
+#include "bab.h"
+#include "graph.h"
+
+using namespace std;
+
+// G(n, p) plus `twins` false twins of random vertices
+static Graph random_graph(int n, double p, int twins, RNG &rng)
+{
+	uniform_real_distribution unif(0.0, 1.0);
+	vector<vector<int>> adj(n);
+	contr_seq edges;
+	for (int u = 0; u < n; ++u)
+		for (int v = u + 1; v < n; ++v)
+			if (unif(rng) < p)
+			{
+				edges.emplace_back(u, v);
+				adj[u].push_back(v);
+				adj[v].push_back(u);
+			}
+	for (int t = 0; t < twins; ++t)
+		for (int w: adj[rng() % n])
+			edges.emplace_back(n + t, w);
+	return Graph::from_edges(n + twins, edges);
+}
+
+// Whether the memo has a move from each kernelized trigraph on the path of its best sequence
+static bool replay_keys_found(const BitGraph &g, const MemType &mem)
+{
+	BitGraph root = g;
+	BitGraph *cur = &root;
+	while (true)
+	{
+		cur->kernelize();
+		if (cur->actual_n() == 1)
+			return true;
+		auto it = mem.find(cur->get_key());
+		if (it == mem.end() || it->second.move.first < 0)
+			return false;
+
+		auto [pu, pv] = it->second.move;
+		int u = -1, v = -1;
+		for (int x: cur->vertices())
+		{
+			if (cur->part(x) == pu)
+				u = x;
+			else if (cur->part(x) == pv)
+				v = x;
+		}
+		if (u < 0 || v < 0)
+			return false;
+		cur = &cur->contract(u, v);
+	}
+}
+
+int main()
+{
+	RNG rng(1);
+	int failures = 0;
+	for (int t = 0; t < 50; ++t)
+	{
+		Graph G = random_graph(12, 0.4, 3, rng);
+		BitGraph g = G.subgraph(G.vertices());
+
+		MemType mem;
+		BitGraph h = g;
+		int min_score = INFTY;
+		mem_bab_aux_lb_init(h, 0, min_score, mem);
+		if (!replay_keys_found(g, mem))
+		{
+			cerr << "graph " << t << ": the replay of the BaB misses memo keys" << endl;
+			++failures;
+		}
+
+		// tww(g) > min_score - 1: the decision BaB kernelizes g in place (see bab_decide),
+		// and stores the key of the kernelized root among the failed ones
+		if (min_score > 0)
+		{
+			unordered_set<string> failed;
+			h = g;
+			mem_bab_decide_aux(h, min_score - 1, failed);
+			if (!h.kernelize().empty() || (h.actual_n() > 1 && failed.count(h.get_key()) == 0))
+			{
+				cerr << "graph " << t << ": the decision BaB did not kernelize its root" << endl;
+				++failures;
+			}
+		}
+	}
+	cout << failures << " failures" << endl;
+	return failures > 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * Tunes the runtime parameters of the solver (see SolverParams) on a training set of .gr files,
+ * separately for each bucket of graphs by number of vertices and average degree,
+ * and writes a profile for the solver (given by $TINYWIDTH_PROFILE or --config, see ParamProfile::installed).
+ *
+ * Each graph of a bucket is solved in a forked child under a time budget.
+ * A set of parameters is better than another on the bucket if it has fewer timeouts,
+ * then a smaller total width, then a smaller total time.
+ * The search is a coordinate descent from the current parameters of the bucket:
+ * each parameter in turn is halved and doubled, and the first change that is better is kept,
+ * until no change helps or after --rounds rounds.
+ *
+ * Usage: tune [--budget SECONDS] [--rounds R] [--seed S] [--out FILE]
+ *             [--config FILE] [--verbose] files...
+ * --config gives a profile to start from (by default, the installed one).
+ */
+#include <chrono>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <poll.h>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+#include "common.h"
+#include "graph.h"
+#include "solver.h"
+#include "context.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Bounds of the buckets: the first size is the largest graph of the dense branch
+const vector<int> N_BOUNDS = {0, BitGraph::VxContainer::MAX_SIZE + 1, 1024, 16384};
+const vector<double> DEG_BOUNDS = {0, 4, 16};
+
+struct Instance
+{
+	string file, gr;
+	int n;
+	double deg;
+};
+
+struct Run
+{
+	bool timeout = false;
+	int width = -1;
+	double wall_s = 0;
+};
+
+// Width of `seq` on g, or -1 if seq is not a valid contraction sequence.
+int replay_width(Graph g, const contr_seq &seq)
+{
+	for (auto [u, v]: seq)
+	{
+		if (u == v || g.is_deleted(u) || g.is_deleted(v))
+			return -1;
+		g.merge_nohint(u, v);
+	}
+	return (g.actual_n() == 1) ? g.full_width() : -1;
+}
+
+/*
+ * Solves the instance with the parameters p in a forked child,
+ * so that it can be killed when it exceeds its time budget.
+ */
+Run run_with_budget(const Instance &inst, const SolverParams &p, double budget_s, uint64_t seed, bool verbose)
+{
+	int fd[2];
+	if (pipe(fd) != 0)
+		return Run{true};
+
+	auto start = steady_clock::now();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(fd[0]);
+		if (!verbose)
+		{
+			int null = open("/dev/null", O_WRONLY);
+			dup2(null, STDERR_FILENO);
+		}
+		SolverContext ctx(seed);
+		ctx.verbose = verbose;
+		ctx.param_profile = ParamProfile();
+		ctx.param_profile.add_line(p.to_string());
+		SolverContext::Scope scope(ctx);
+		istringstream is(inst.gr);
+		Graph g = Graph::from_istream(is);
+		Graph g0 = g;
+		string res = to_string(replay_width(move(g0), solve(g)));
+		ssize_t written = write(fd[1], res.data(), res.size());
+		_exit(written == (ssize_t)res.size() ? 0 : 1);
+	}
+	close(fd[1]);
+
+	string res;
+	char buf[256];
+	Run run;
+	while (true)
+	{
+		double left = budget_s - duration<double>(steady_clock::now() - start).count();
+		if (left <= 0)
+		{
+			run.timeout = true;
+			break;
+		}
+		pollfd pfd{fd[0], POLLIN, 0};
+		if (poll(&pfd, 1, (int)(left * 1000) + 1) == 0)
+			continue;
+		ssize_t r = read(fd[0], buf, sizeof(buf));
+		if (r <= 0)
+			break;
+		res.append(buf, r);
+	}
+	close(fd[0]);
+
+	if (run.timeout)
+		kill(pid, SIGKILL);
+	int status;
+	waitpid(pid, &status, 0);
+
+	run.wall_s = run.timeout ? budget_s : duration<double>(steady_clock::now() - start).count();
+	istringstream is(res);
+	if (!run.timeout && (!(is >> run.width) || run.width < 0))
+	{
+		cerr << "Invalid solution for " << inst.file << endl;
+		run.timeout = true;
+	}
+	return run;
+}
+
+constexpr double TIME_GAIN = 0.05;
+
+// (timeouts, total width, total time) of p on the instances
+using Score = tuple<int, long long, double>;
+
+bool better(const Score &a, const Score &b)
+{
+	auto ka = make_pair(get<0>(a), get<1>(a)), kb = make_pair(get<0>(b), get<1>(b));
+	return ka < kb || (ka == kb && get<2>(a) < (1 - TIME_GAIN) * get<2>(b));
+}
+
+Score evaluate(const vector<const Instance *> &insts, const SolverParams &p,
+			   double budget_s, uint64_t seed, bool verbose)
+{
+	Score res{0, 0, 0};
+	for (auto *inst: insts)
+	{
+		Run run = run_with_budget(*inst, p, budget_s, seed, verbose);
+		if (run.timeout)
+			++get<0>(res);
+		else
+			get<1>(res) += run.width;
+		get<2>(res) += run.wall_s;
+	}
+	cerr << "  " << p.to_string() << ": timeouts " << get<0>(res)
+		 << ", width " << get<1>(res) << ", time " << get<2>(res) << endl;
+	return res;
+}
+
+// Parameters p with `name` multiplied by `factor`, if it gives a different valid value
+bool scaled(const SolverParams &p, const string &name, double factor, SolverParams &res)
+{
+	int x = *p.get(name);
+	int y = (x == 0 && factor > 1) ? 1 : (int)(x * factor);
+	res = p;
+	return y != x && res.set(name + "=" + to_string(y));
+}
+
+SolverParams tune_bucket(const vector<const Instance *> &insts, SolverParams best,
+						 double budget_s, int rounds, uint64_t seed, bool verbose)
+{
+	Score best_score = evaluate(insts, best, budget_s, seed, verbose);
+	for (int round = 0; round < rounds; ++round)
+	{
+		bool improved = false;
+		for (auto &name: SolverParams::names())
+			for (double factor: {0.5, 2.0})
+			{
+				SolverParams cand;
+				if (!scaled(best, name, factor, cand))
+					continue;
+				Score score = evaluate(insts, cand, budget_s, seed, verbose);
+				if (better(score, best_score))
+				{
+					best = cand;
+					best_score = score;
+					improved = true;
+					break;
+				}
+			}
+		if (!improved)
+			break;
+	}
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	double budget = 30;
+	int rounds = 3;
+	uint64_t seed = 42;
+	string out = "tinywidth.profile";
+	bool verbose = false;
+	ParamProfile start = ParamProfile::installed();
+	vector<string> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--verbose")
+			verbose = true;
+		else if ((arg == "--budget" || arg == "--rounds" || arg == "--seed"
+				  || arg == "--out" || arg == "--config") && i + 1 < argc)
+		{
+			string val = argv[++i];
+			if (arg == "--budget")
+				budget = stod(val);
+			else if (arg == "--rounds")
+				rounds = stoi(val);
+			else if (arg == "--seed")
+				seed = stoull(val);
+			else if (arg == "--out")
+				out = val;
+			else
+			{
+				start = ParamProfile();
+				if (!start.add_file(val))
+					return 1;
+			}
+		}
+		else if (!arg.empty() && arg[0] == '-')
+		{
+			cerr << "Unknown argument: " << arg << endl;
+			return 1;
+		}
+		else
+			files.push_back(arg);
+	}
+	if (files.empty())
+	{
+		cerr << "No training files" << endl;
+		return 1;
+	}
+
+	// Same size and degree as seen by solve()
+	vector<Instance> insts;
+	for (auto &file: files)
+	{
+		ifstream ifs(file);
+		string gr((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+		istringstream is(gr);
+		Graph g = Graph::from_istream(is);
+		long long deg = 0;
+		for (int u: g.vertices())
+			deg += g.total_deg(u);
+		int n = g.actual_n();
+		insts.push_back(Instance{file, move(gr), n, n > 0 ? (double)deg / n : 0});
+	}
+
+	ParamProfile res;
+	for (size_t i = 0; i < N_BOUNDS.size(); ++i)
+		for (size_t j = 0; j < DEG_BOUNDS.size(); ++j)
+		{
+			ParamProfile::Bucket b;
+			b.min_n = N_BOUNDS[i];
+			b.max_n = (i + 1 < N_BOUNDS.size()) ? N_BOUNDS[i + 1] : -1;
+			b.min_deg = DEG_BOUNDS[j];
+			b.max_deg = (j + 1 < DEG_BOUNDS.size()) ? DEG_BOUNDS[j + 1] : -1;
+
+			vector<const Instance *> bucket;
+			for (auto &inst: insts)
+				if (b.contains(inst.n, inst.deg))
+					bucket.push_back(&inst);
+			if (bucket.empty())
+				continue;
+
+			cerr << "Bucket n in [" << b.min_n << ", " << b.max_n << "), deg in ["
+				 << b.min_deg << ", " << b.max_deg << "): " << bucket.size() << " graphs" << endl;
+			SolverParams p = start.select(b.min_n, b.min_deg);
+			p = tune_bucket(bucket, p, budget, rounds, seed, verbose);
+
+			istringstream values(p.to_string());
+			for (string v; values >> v;)
+				b.values.push_back(v);
+			res.buckets.push_back(move(b));
+		}
+
+	ofstream ofs(out);
+	ofs << "# Generated by tune on " << files.size() << " graphs, budget " << budget << " s\n";
+	res.write(ofs);
+	cerr << "Profile written to " << out << endl;
+	return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * Standalone verifier for contraction sequences.
+ *
+ * Replays a contraction sequence on a .gr graph and reports its width
+ * (the maximum red degree over the whole sequence) and the first contraction
+ * at which that maximum is reached.
+ *
+ * Adjacencies are stored as hash sets, so each edge update is O(1) expected.
+ * A contraction of v into u scans the neighbors of v, and the black neighbors of u:
+ * the ones that are not black neighbors of v become red, so the scan is paid for by N(v) or by the changes.
+ * The red degrees are only checked on the vertices that get a new red edge.
+ * The cost of a contraction is thus linear in deg(v) plus the number of edges it changes.
+ *
+ * Usage: verify graph.gr [solution]    (the solution is read from stdin if omitted)
+ * Exits with a nonzero status if the sequence is not valid.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+/*************** Fast input ***************/
+class Reader
+{
+public:
+	explicit Reader(FILE *f)
+	{
+		char buf[1 << 16];
+		size_t r;
+		while ((r = fread(buf, 1, sizeof(buf), f)) > 0)
+			data.append(buf, r);
+	}
+
+	// Skips empty lines and comment lines (starting with 'c').
+	bool next_line()
+	{
+		while (pos < data.size())
+		{
+			while (pos < data.size() && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r' || data[pos] == '\n'))
+				++pos;
+			if (pos < data.size() && data[pos] == 'c')
+				skip_line();
+			else
+				break;
+		}
+		return pos < data.size();
+	}
+
+	void skip_line()
+	{
+		while (pos < data.size() && data[pos] != '\n')
+			++pos;
+	}
+
+	void skip_word()
+	{
+		skip_spaces();
+		while (pos < data.size() && !isspace((unsigned char)data[pos]))
+			++pos;
+	}
+
+	bool read_int(long long &x)
+	{
+		skip_spaces();
+		if (pos >= data.size() || !isdigit((unsigned char)data[pos]))
+			return false;
+		x = 0;
+		while (pos < data.size() && isdigit((unsigned char)data[pos]))
+			x = 10 * x + (data[pos++] - '0');
+		return true;
+	}
+
+private:
+	string data;
+	size_t pos = 0;
+
+	void skip_spaces()
+	{
+		while (pos < data.size() && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r'))
+			++pos;
+	}
+};
+
+/*************** Trigraph ***************/
+using Set = unordered_set<int>;
+
+class Trigraph
+{
+public:
+	explicit Trigraph(int n): black(n), red(n), alive(n, true), n_alive(n) { }
+
+	int n() const { return black.size(); }
+	int actual_n() const { return n_alive; }
+	bool is_alive(int u) const { return alive[u]; }
+
+	void add_edge(int u, int v)
+	{
+		black[u].insert(v);
+		black[v].insert(u);
+	}
+
+	/*
+	 * Merges v into u, and returns the maximum red degree
+	 * among the vertices whose red degree may have increased:
+	 * u and the vertices that get a new red edge to u.
+	 */
+	int merge(int u, int v)
+	{
+		Set &bu = black[u], &ru = red[u], &bv = black[v], &rv = red[v];
+		bu.erase(v);
+		ru.erase(v);
+		bv.erase(u);
+		rv.erase(u);
+		changed.clear();
+
+		// Black edges of u that v does not have become red.
+		// The ones that stay black are black neighbors of v.
+		for (int x: bu)
+			if (!bv.contains(x))
+				changed.push_back(x);
+		for (int x: changed)
+		{
+			bu.erase(x);
+			black[x].erase(u);
+			ru.insert(x);
+			red[x].insert(u);
+		}
+
+		// Neighbors of v lose v, and get a red edge to u unless both edges are black
+		for (int x: bv)
+		{
+			black[x].erase(v);
+			if (!bu.contains(x) && ru.insert(x).second)
+			{
+				red[x].insert(u);
+				changed.push_back(x);
+			}
+		}
+		for (int x: rv)
+		{
+			red[x].erase(v);
+			if (bu.erase(x))
+				black[x].erase(u);
+			if (ru.insert(x).second)
+			{
+				red[x].insert(u);
+				changed.push_back(x);
+			}
+		}
+
+		Set().swap(bv);
+		Set().swap(rv);
+		alive[v] = false;
+		--n_alive;
+
+		int res = ru.size();
+		for (int x: changed)
+			res = max(res, (int)red[x].size());
+		return res;
+	}
+
+private:
+	vector<Set> black, red;
+	vector<bool> alive;
+	int n_alive;
+	vector<int> changed;
+};
+
+int fail(const string &msg)
+{
+	cerr << "invalid: " << msg << endl;
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2 || argc > 3)
+	{
+		cerr << "Usage: " << argv[0] << " graph.gr [solution]" << endl;
+		return 2;
+	}
+
+	FILE *fg = fopen(argv[1], "r");
+	if (!fg)
+		return fail(string("cannot open ") + argv[1]);
+	Reader rg(fg);
+	fclose(fg);
+
+	long long n, m;
+	if (!rg.next_line())
+		return fail("empty graph file");
+	rg.skip_word(); // p
+	rg.skip_word(); // tww
+	if (!rg.read_int(n) || !rg.read_int(m))
+		return fail("bad header");
+
+	Trigraph g(n);
+	for (long long i = 0; i < m; ++i)
+	{
+		long long u, v;
+		if (!rg.next_line() || !rg.read_int(u) || !rg.read_int(v))
+			return fail("missing edges");
+		if (u < 1 || u > n || v < 1 || v > n)
+			return fail("edge out of range at line " + to_string(i + 2));
+		if (u == v)
+			continue;
+		g.add_edge(u - 1, v - 1);
+	}
+
+	FILE *fs = (argc == 3) ? fopen(argv[2], "r") : stdin;
+	if (!fs)
+		return fail(string("cannot open ") + argv[2]);
+	Reader rs(fs);
+	if (fs != stdin)
+		fclose(fs);
+
+	int width = 0;
+	long long step = 0, peak_step = 0;
+	long long peak_u = 0, peak_v = 0;
+	while (rs.next_line())
+	{
+		long long u, v;
+		++step;
+		if (!rs.read_int(u) || !rs.read_int(v))
+			return fail("malformed contraction " + to_string(step));
+		if (u < 1 || u > n || v < 1 || v > n || u == v)
+			return fail("bad contraction " + to_string(step) + ": " + to_string(u) + " " + to_string(v));
+		if (!g.is_alive(u - 1) || !g.is_alive(v - 1))
+			return fail("contraction " + to_string(step) + " uses a contracted vertex: " + to_string(u) + " " + to_string(v));
+
+		int w = g.merge(u - 1, v - 1);
+		if (w > width)
+		{
+			width = w;
+			peak_step = step;
+			peak_u = u;
+			peak_v = v;
+		}
+		rs.skip_line();
+	}
+
+	if (g.actual_n() != 1)
+		return fail(to_string(g.actual_n()) + " vertices remain after " + to_string(step) + " contractions");
+
+	cout << "contractions: " << step << "\n"
+		 << "twin-width: " << width << "\n"
+		 << "first peak at contraction: " << peak_step;
+	if (peak_step > 0)
+		cout << " (" << peak_u << " " << peak_v << ")";
+	cout << endl;
+
+	return 0;
+}